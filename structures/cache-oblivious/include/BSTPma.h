@@ -0,0 +1,227 @@
+#pragma once
+#include "IBST.h"
+#include "VebLayout.h"
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+// Dynamic cache-oblivious ordered set: the keys sit in sorted order in a
+// packed memory array (Bender, Demaine and Farach-Colton) of 2^k slots cut
+// into segments of about log2 of that many slots, each holding its keys
+// packed at its front. A segment that overflows, or underflows on erase, is
+// rebalanced with the smallest aligned window of 2, 4, 8, ... segments
+// whose density is within that level's thresholds, spreading the window's
+// keys evenly; the thresholds tighten linearly from the segments to the
+// whole array, where a violation resizes it to twice the keys. That keeps
+// every segment non-empty and moves O(log^2 n) keys per update amortised.
+//
+// Segments are found through a static index of their first keys in the
+// height-split vEB layout (see VebLayout.h). A rebalance rewrites only the
+// index entries of its window in place; the layout is rebuilt when the
+// array is resized.
+template<class Key>
+class BSTPma : public IBST<Key> {
+    using Index = std::uint32_t;
+
+    // first key of segment seg
+    struct Entry {
+        Key   min;
+        Index seg;
+    };
+
+    static constexpr std::size_t kMinCapacity = 8;
+    static constexpr double kTauLeaf = 1.0,   kTauRoot = 0.75;   // upper densities
+    static constexpr double kRhoLeaf = 0.125, kRhoRoot = 0.25;   // lower densities
+
+    std::vector<Key>   slots_;       // segments of seg_ slots
+    std::vector<Index> count_;       // keys per segment
+    std::size_t        seg_  = 0;    // slots per segment, a power of two
+    unsigned           levels_ = 0;  // log2 of the number of segments
+    std::size_t        n_    = 0;
+
+    std::vector<Entry> index_;       // vEB layout over the segments
+    std::vector<Index> where_;       // index_ slot of every segment
+    help::VebTables    tables_;
+    std::uint64_t      far_  = 0;    // tables_.farLevels
+
+    std::uint64_t      moved_ = 0;   // keys written by rebalances and resizes
+
+    std::size_t segments() const { return count_.size(); }
+    const Key*  begin(std::size_t s) const { return slots_.data() + s * seg_; }
+    Key*        begin(std::size_t s)       { return slots_.data() + s * seg_; }
+
+    // Thresholds of a window l levels above the segments.
+    double upper(unsigned l) const { return levels_ ? kTauLeaf - (kTauLeaf - kTauRoot) * l / levels_ : kTauRoot; }
+    double lower(unsigned l) const { return levels_ ? kRhoLeaf + (kRhoRoot - kRhoLeaf) * l / levels_ : 0.0; }
+
+    // Last segment whose first key is <= k, segment 0 if there is none.
+    std::size_t segmentOf(const Key& k) const
+    {
+        const std::size_t n = index_.size();
+        if (n < 2) return 0;
+        const unsigned h = tables_.height;
+        std::size_t path[64];
+        std::size_t cand = n, p = 0, i = 1;
+        path[0] = 0;
+        for (unsigned d = 0; ; ) {
+            if (d + 2 < h && (far_ >> (d + 2)) & 1)
+                tables_.prefetchGrandchildren(index_.data(), n, path, d, i);
+            const bool right = !(k < index_[p].min);
+            cand = right ? p : cand;
+            if (++d == h) break;
+            i = 2*i + right;
+            p = tables_.pos(path, d, i);
+            if (p >= n) break;
+            path[d] = p;
+        }
+        return cand == n ? 0 : index_[cand].seg;
+    }
+
+    void setMin(std::size_t s) { index_[where_[s]].min = *begin(s); }
+
+    // Spreads the sorted keys evenly over segments [lo, lo + w).
+    void spread(const std::vector<Key>& keys, std::size_t lo, std::size_t w)
+    {
+        const std::size_t m = keys.size();
+        for (std::size_t j = 0, at = 0; j < w; ++j) {
+            const std::size_t c = m / w + (j < m % w);
+            std::copy(keys.begin() + at, keys.begin() + at + c, begin(lo + j));
+            count_[lo + j] = Index(c);
+            at += c;
+        }
+        moved_ += m;
+    }
+
+    // The keys of segments [lo, lo + w) in order.
+    std::vector<Key> gather(std::size_t lo, std::size_t w) const
+    {
+        std::vector<Key> keys;
+        for (std::size_t s = lo; s < lo + w; ++s) keys.insert(keys.end(), begin(s), begin(s) + count_[s]);
+        return keys;
+    }
+
+    // Rebuilds the array for the given keys at twice their number (at
+    // least kMinCapacity slots), then the index.
+    void resize(const std::vector<Key>& keys)
+    {
+        const std::size_t cap = std::max(kMinCapacity, std::bit_ceil(2 * keys.size()));
+        seg_    = std::min(cap, std::max<std::size_t>(8, std::bit_ceil<std::size_t>(std::bit_width(cap))));
+        levels_ = std::bit_width(cap / seg_) - 1;
+        slots_.assign(cap, Key{});
+        count_.assign(cap / seg_, 0);
+        spread(keys, 0, segments());
+
+        const std::size_t segs = segments();
+        tables_ = help::VebTables(std::bit_width(segs));
+        far_    = tables_.farLevels(sizeof(Entry));
+        index_.assign(segs, Entry{});
+        where_.assign(segs, 0);
+        Index s = 0;
+        help::vebInorder(tables_, segs, 1, 0, 0, tables_.height, [&](std::size_t p) {
+            index_[p] = Entry{*begin(s), s};
+            where_[s++] = Index(p);
+        });
+    }
+
+    // Rebalances the smallest window around segment s whose density after
+    // the update (keys + delta) is within its thresholds, or resizes.
+    void rebalance(std::size_t s, int delta, const Key* extra)
+    {
+        std::size_t m = count_[s] + delta;
+        for (unsigned l = 1; l <= levels_; ++l) {
+            const std::size_t w  = std::size_t(1) << l;
+            const std::size_t lo = s & ~(w - 1);
+            const std::size_t half = lo == (s & ~(w/2 - 1)) ? lo + w/2 : lo;   // the sibling half
+            for (std::size_t t = half; t < half + w/2; ++t) m += count_[t];
+            const double cap = double(w * seg_);
+            if (m <= upper(l) * cap && m >= lower(l) * cap) {
+                std::vector<Key> keys = gather(lo, w);
+                if (extra) keys.insert(std::upper_bound(keys.begin(), keys.end(), *extra), *extra);
+                spread(keys, lo, w);
+                for (std::size_t t = lo; t < lo + w; ++t) setMin(t);
+                return;
+            }
+        }
+        std::vector<Key> keys = gather(0, segments());
+        if (extra) keys.insert(std::upper_bound(keys.begin(), keys.end(), *extra), *extra);
+        resize(keys);
+    }
+
+public:
+    BSTPma() { resize({}); }
+
+    void insert(const Key& k) override
+    {
+        const std::size_t s = segmentOf(k);
+        Key* b = begin(s);
+        Key* e = b + count_[s];
+        Key* at = std::lower_bound(b, e, k);
+        if (at != e && *at == k) return;
+        ++n_;
+
+        if (count_[s] < kTauLeaf * seg_ && (levels_ || count_[s] + 1 <= kTauRoot * seg_)) {
+            std::copy_backward(at, e, e + 1);
+            *at = k;
+            ++count_[s];
+            if (at == b) setMin(s);
+            return;
+        }
+        rebalance(s, 1, &k);
+    }
+
+    // Removes k; false if it was not in the set.
+    bool erase(const Key& k)
+    {
+        const std::size_t s = segmentOf(k);
+        Key* b = begin(s);
+        Key* e = b + count_[s];
+        Key* at = std::lower_bound(b, e, k);
+        if (at == e || !(*at == k)) return false;
+        --n_;
+
+        std::copy(at + 1, e, at);
+        --count_[s];
+        if (!levels_ || count_[s] >= kRhoLeaf * seg_) {
+            if (at == b && count_[s]) setMin(s);
+            return true;
+        }
+        rebalance(s, 0, nullptr);
+        return true;
+    }
+
+    bool contains(const Key& k) const override
+    {
+        const std::size_t s = segmentOf(k);
+        const Key* e = begin(s) + count_[s];
+        const Key* at = std::lower_bound(begin(s), e, k);
+        return at != e && *at == k;
+    }
+
+    // Calls visit(key) for the keys in [lo, hi) in order; returns how many.
+    template<class Visit>
+    std::size_t range(const Key& lo, const Key& hi, Visit visit) const
+    {
+        std::size_t c = 0;
+        std::size_t s = segmentOf(lo);
+        const Key* at = std::lower_bound(begin(s), begin(s) + count_[s], lo);
+        for (; s < segments(); ++s, at = begin(s)) {
+            for (const Key* e = begin(s) + count_[s]; at != e; ++at) {
+                if (!(*at < hi)) return c;
+                visit(*at);
+                ++c;
+            }
+        }
+        return c;
+    }
+
+    std::size_t size_bytes() const override {
+        return slots_.capacity() * sizeof(Key) + count_.capacity() * sizeof(Index)
+             + index_.capacity() * sizeof(Entry) + where_.capacity() * sizeof(Index);
+    }
+
+    std::size_t   size()     const { return n_; }
+    std::size_t   capacity() const { return slots_.size(); }
+    std::uint64_t moved()    const { return moved_; }
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include "IBST.h"
+#include "RadixSort.h"
+#include "InPlaceLayout.h"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+
+// Sorted keys in preorder, (mid, left, right): a node's left subtree
+// follows it directly and its right subtree after that. The top of the
+// tree is contiguous, but a deep search jumps by half the remaining range
+// at every level; see BSTVEB for the height-split layout.
+template<class Key>
+class BSTPreorder : public IBST<Key> {
+    std::vector<Key> a_;            
+    bool              frozen_ = false;
+    std::vector<Key>  inserts_;     
+
+    bool containsRec(const Key& k,
+                     std::size_t lo, std::size_t hi, std::size_t idx) const
+    {
+        if (lo >= hi) return false;            
+
+        const Key& key = a_[idx];
+        if (k == key) return true;
+
+        std::size_t mid        = (lo + hi) / 2;
+        std::size_t left_size  = mid - lo;    
+        std::size_t left_idx   = idx + 1;   
+        std::size_t right_idx  = idx + 1 + left_size;
+
+        return (k < key)
+             ? containsRec(k, lo, mid,           left_idx)
+             : containsRec(k, mid + 1, hi,       right_idx);
+    }
+
+public:
+    // Sorts and lays out the inserted keys; lookups see them from then on
+    // and further inserts throw. Call it once the keys are in, before the
+    // first lookup.
+    void build() {
+        if (frozen_) return;
+
+        // sorted and laid out where the inserts are; their buffer becomes a_
+        help::sortUnique(inserts_, std::less<Key>{}, std::equal_to<Key>{}, true);
+        help::preorderInPlace(inserts_.data(), inserts_.size());
+        a_ = std::move(inserts_);
+        inserts_ = {};
+        frozen_ = true;
+    }
+
+    void insert(const Key& k) override {
+        if (frozen_)
+            throw std::logic_error("I am already frozen!");
+        inserts_.push_back(k);
+    }
+
+    bool contains(const Key& k) const override {
+        return containsRec(k, 0, a_.size(), 0);
+    }
+
+     std::size_t size_bytes() const override { return a_.size() * sizeof(Key); }
+};
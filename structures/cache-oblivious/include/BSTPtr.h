@@ -1,42 +1,143 @@
 #pragma once
 #include "IBST.h"
-#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <utility>
 
-template<class Key>
+// AVL tree whose nodes live in one vector and link by 32-bit index, slot 0
+// being the null child (height 0). Inserts walk down iteratively, keep the
+// path, and retrace it with the usual single/double rotations until a
+// subtree height is unchanged; the height stays within 1.44 log2 n for any
+// insert order. All nodes go with the one allocation. compact() renumbers
+// the nodes in breadth-first order once the tree is loaded, so the top
+// levels share cache lines and each level is contiguous; CompactBfs marks
+// the variant the benchmark compacts after its inserts (BST_PTR_BFS).
+template<class Key, bool CompactBfs = false>
 class BSTPtr : public IBST<Key> {
+    using Index = std::uint32_t;
+
     struct Node {
-        Key key;
-        std::unique_ptr<Node> l, r;
-        explicit Node(const Key& k) : key(k) {}
+        Key          key;
+        Index        l = 0, r = 0;
+        std::uint8_t h = 0;
     };
 
-    std::unique_ptr<Node> root_;
-    std::size_t node_cnt_ = 0;
-
-    void insertNode(std::unique_ptr<Node>& p, const Key& k) {
-        if (!p) {
-            p = std::make_unique<Node>(k);
-            ++node_cnt_;                         
-        } else if (k < p->key) {
-            insertNode(p->l, k);
-        } else if (k > p->key) {
-            insertNode(p->r, k);
+    static constexpr std::size_t kMaxHeight = 64;   // AVL over < 2^32 nodes stays below 47
+
+    std::vector<Node> nodes_ = std::vector<Node>(1);  // nodes_[0] is the null node
+    Index             root_  = 0;
+
+    std::uint8_t height(Index x) const { return nodes_[x].h; }
+
+    void update(Index x) {
+        Node& n = nodes_[x];
+        n.h = std::uint8_t(1 + std::max(height(n.l), height(n.r)));
+    }
+
+    Index rotateRight(Index x) {
+        const Index y = nodes_[x].l;
+        nodes_[x].l = nodes_[y].r;
+        nodes_[y].r = x;
+        update(x);
+        update(y);
+        return y;
+    }
+
+    Index rotateLeft(Index x) {
+        const Index y = nodes_[x].r;
+        nodes_[x].r = nodes_[y].l;
+        nodes_[y].l = x;
+        update(x);
+        update(y);
+        return y;
+    }
+
+    // Restores the balance of x after one of its subtrees grew by one;
+    // returns the root of the subtree.
+    Index rebalance(Index x) {
+        update(x);
+        const int bal = int(height(nodes_[x].l)) - int(height(nodes_[x].r));
+        if (bal > 1) {
+            const Index l = nodes_[x].l;
+            if (height(nodes_[l].l) < height(nodes_[l].r)) nodes_[x].l = rotateLeft(l);
+            return rotateRight(x);
+        }
+        if (bal < -1) {
+            const Index r = nodes_[x].r;
+            if (height(nodes_[r].r) < height(nodes_[r].l)) nodes_[x].r = rotateRight(r);
+            return rotateLeft(x);
+        }
+        return x;
+    }
+
+public:
+    void insert(const Key& k) override {
+        Index path[kMaxHeight];
+        std::size_t depth = 0;
+        for (Index x = root_; x; ) {
+            const Node& n = nodes_[x];
+            if (k == n.key) return;
+            path[depth++] = x;
+            x = k < n.key ? n.l : n.r;
         }
+
+        if (nodes_.size() > std::numeric_limits<Index>::max())
+            throw std::length_error("BSTPtr: more than 2^32 - 1 nodes");
+        const Index leaf = Index(nodes_.size());
+        nodes_.push_back(Node{k, 0, 0, 1});
+
+        // relink the new subtree root of every level on the way up
+        Index child = leaf;
+        while (depth--) {
+            const Index x = path[depth];
+            Node& n = nodes_[x];
+            (k < n.key ? n.l : n.r) = child;
+            const std::uint8_t before = n.h;
+            child = rebalance(x);
+            if (nodes_[child].h == before) {
+                if (depth) {
+                    Node& p = nodes_[path[depth - 1]];
+                    (k < p.key ? p.l : p.r) = child;
+                } else {
+                    root_ = child;
+                }
+                return;
+            }
+        }
+        root_ = child;
     }
 
-    static bool contains(const std::unique_ptr<Node>& p, const Key& k) {
-        const Node* cur = p.get();
-        while (cur) {
-            if (k == cur->key) return true;
-            cur = (k < cur->key) ? cur->l.get() : cur->r.get();
+    bool contains(const Key& k) const override {
+        for (Index x = root_; x; ) {
+            const Node& n = nodes_[x];
+            if (k == n.key) return true;
+            x = k < n.key ? n.l : n.r;
         }
         return false;
     }
 
-public:
-    void insert(const Key& k) override { insertNode(root_, k); }
-    bool contains(const Key& k) const override { return contains(root_, k); }
+    // Renumbers the nodes in breadth-first order into an exactly sized
+    // vector; the tree stays an AVL tree and takes further inserts.
+    void compact() {
+        std::vector<Node> out;
+        out.reserve(nodes_.size());
+        out.push_back(Node{});
+        if (root_) out.push_back(nodes_[root_]);
+        for (std::size_t i = 1; i < out.size(); ++i) {
+            const Index l = out[i].l, r = out[i].r;
+            if (l) { out[i].l = Index(out.size()); out.push_back(nodes_[l]); }
+            if (r) { out[i].r = Index(out.size()); out.push_back(nodes_[r]); }
+        }
+        nodes_.swap(out);
+        root_ = nodes_.size() > 1 ? 1 : 0;
+    }
+
+    // The node array as allocated, unused capacity and the null node included.
+    std::size_t size_bytes() const override { return nodes_.capacity() * sizeof(Node); }
 
-    std::size_t size_bytes() const override { return node_cnt_ * sizeof(Node); }
+    std::size_t size()         const { return nodes_.size() - 1; }
+    unsigned    tree_height()  const { return height(root_); }
 };
@@ -1,61 +1,66 @@
 #pragma once
 #include "IBST.h"
+#include "RadixSort.h"
+#include "VebLayout.h"
+#include "InPlaceLayout.h"
 #include <vector>
 #include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <stdexcept>
+#include <functional>
 
-
-namespace help {
-template<class Key>
-void build_veb(std::vector<Key>& out,
-               const std::vector<Key>& sorted, std::size_t lo, std::size_t hi)
-{
-    if (lo >= hi) return;                       
-    std::size_t mid = (lo + hi) / 2;            
-    out.push_back(sorted[mid]);                 
-    build_veb(out, sorted, lo, mid);            
-    build_veb(out, sorted, mid + 1, hi);        
-}
-} 
-
+// Height-split van Emde Boas layout (see VebLayout.h), navigated through
+// the per-depth tables instead of pointers or subtree ranges.
 template<class Key>
 class BSTVEB : public IBST<Key> {
-    std::vector<Key> a_;            
+    std::vector<Key> a_;
+    help::VebTables   tables_;
+    std::uint64_t     far_ = 0;      // tables_.farLevels
     bool              frozen_ = false;
-    std::vector<Key>  inserts_;     
+    std::vector<Key>  inserts_;
 
+    // Walks down from the root until k is found or the next child does not
+    // exist (its position is past the keys). Where the cut two levels down
+    // leaves the current cache line, the grandchildren are prefetched
+    // before the comparison.
+    bool find(const Key& k) const
+    {
+        const std::size_t n = a_.size();
+        const unsigned    h = tables_.height;
+        std::size_t path[64];
+        std::size_t p = 0, i = 1;
+        path[0] = 0;
+        for (unsigned d = 0; n; ) {
+            if (d + 2 < h && (far_ >> (d + 2)) & 1)
+                tables_.prefetchGrandchildren(a_.data(), n, path, d, i);
+            const Key& key = a_[p];
+            if (k == key) return true;
+            if (++d == h) return false;
+            i = 2*i + (key < k);
+            p = tables_.pos(path, d, i);
+            if (p >= n) return false;
+            path[d] = p;
+        }
+        return false;
+    }
 
-    void freeze() {
+public:
+    // Freezes the inserted keys into the layout, once all are in; contains()
+    // answers from the layout only, and inserting afterwards throws.
+    void build() {
         if (frozen_) return;
 
-        std::sort(inserts_.begin(), inserts_.end());
-        inserts_.erase(std::unique(inserts_.begin(), inserts_.end()),
-                       inserts_.end());
-
-        a_.reserve(inserts_.size());
-        help::build_veb(a_, inserts_, 0, inserts_.size());
+        // sorted and laid out where the inserts are; their buffer becomes a_
+        help::sortUnique(inserts_, std::less<Key>{}, std::equal_to<Key>{}, true);
+        tables_ = help::VebTables(std::bit_width(inserts_.size()));
+        far_    = tables_.farLevels(sizeof(Key));
+        help::vebInPlace(inserts_.data(), inserts_.size(), tables_);
+        a_ = std::move(inserts_);
+        inserts_ = {};
         frozen_ = true;
     }
 
-    bool containsRec(const Key& k,
-                     std::size_t lo, std::size_t hi, std::size_t idx) const
-    {
-        if (lo >= hi) return false;            
-
-        const Key& key = a_[idx];
-        if (k == key) return true;
-
-        std::size_t mid        = (lo + hi) / 2;
-        std::size_t left_size  = mid - lo;    
-        std::size_t left_idx   = idx + 1;   
-        std::size_t right_idx  = idx + 1 + left_size;
-
-        return (k < key)
-             ? containsRec(k, lo, mid,           left_idx)
-             : containsRec(k, mid + 1, hi,       right_idx);
-    }
-
-public:
     void insert(const Key& k) override {
         if (frozen_)
             throw std::logic_error("I am already frozen!");
@@ -63,8 +68,7 @@ public:
     }
 
     bool contains(const Key& k) const override {
-        const_cast<BSTVEB*>(this)->freeze();   
-        return containsRec(k, 0, a_.size(), 0);
+        return find(k);
     }
 
      std::size_t size_bytes() const override { return a_.size() * sizeof(Key); }
@@ -0,0 +1,126 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace latency {
+
+// Timestamp in TSC ticks. rdtscp waits for the preceding instructions to
+// retire and the lfence keeps later ones from starting early, so a pair of
+// calls brackets exactly the code in between. Without a TSC it falls back
+// to steady_clock nanoseconds.
+inline std::uint64_t now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned aux;
+    std::uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Smallest of many back-to-back readings: the cost of the timer itself.
+inline std::uint64_t overhead()
+{
+    static const std::uint64_t cost = [] {
+        std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+        for (int i = 0; i < 10'000; ++i) {
+            std::uint64_t a = now(), b = now();
+            best = std::min(best, b - a);
+        }
+        return best;
+    }();
+    return cost;
+}
+
+// Ticks per nanosecond, measured once against steady_clock over ~20ms.
+inline double ticksPerNs()
+{
+    static const double rate = [] {
+        using Clock = std::chrono::steady_clock;
+        auto          c0 = Clock::now();
+        std::uint64_t t0 = now();
+        while (Clock::now() - c0 < std::chrono::milliseconds(20)) {}
+        std::uint64_t t1 = now();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - c0).count();
+        return ns > 0 ? double(t1 - t0) / ns : 1.0;
+    }();
+    return rate;
+}
+
+// Log-linear histogram in the style of HdrHistogram: values below 2^S
+// are exact, above that every power of two is split into 2^S buckets, so
+// a bucket is within 1/2^S of any value it holds. The maximum is kept
+// exactly.
+class Histogram {
+    static constexpr unsigned S = 6;
+    static constexpr unsigned kBuckets = (64 - S + 1) << S;
+
+    std::array<std::uint64_t, kBuckets> count_{};
+    std::uint64_t                       total_ = 0, max_ = 0;
+
+    static unsigned bucket(std::uint64_t v)
+    {
+        if (v < (std::uint64_t(1) << S)) return unsigned(v);
+        unsigned shift = std::bit_width(v) - 1 - S;
+        return ((shift + 1) << S) + unsigned((v >> shift) - (std::uint64_t(1) << S));
+    }
+
+    // Midpoint of the values that land in bucket b.
+    static std::uint64_t value(unsigned b)
+    {
+        if (b < (1u << S)) return b;
+        unsigned      shift = (b >> S) - 1;
+        std::uint64_t lo    = ((std::uint64_t(1) << S) + (b & ((1u << S) - 1))) << shift;
+        return lo + ((std::uint64_t(1) << shift) >> 1);
+    }
+
+public:
+    void record(std::uint64_t v)
+    {
+        ++count_[bucket(v)];
+        ++total_;
+        max_ = std::max(max_, v);
+    }
+
+    void merge(const Histogram& o)
+    {
+        for (unsigned b = 0; b < kBuckets; ++b) count_[b] += o.count_[b];
+        total_ += o.total_;
+        max_    = std::max(max_, o.max_);
+    }
+
+    std::uint64_t count() const { return total_; }
+    std::uint64_t max()   const { return max_; }
+
+    // Value at quantile p in [0, 1], never above the recorded maximum.
+    std::uint64_t percentile(double p) const
+    {
+        if (!total_) return 0;
+        std::uint64_t rank = std::max<std::uint64_t>(1, std::uint64_t(p * total_ + 0.5)), seen = 0;
+        for (unsigned b = 0; b < kBuckets; ++b)
+            if ((seen += count_[b]) >= rank) return std::min(value(b), max_);
+        return max_;
+    }
+};
+
+// Times fn() between two timestamps, minus the timer overhead, in ticks.
+template<class Fn>
+inline std::uint64_t measure(Fn&& fn)
+{
+    std::uint64_t t0 = now();
+    fn();
+    std::uint64_t t1 = now(), dt = t1 - t0, o = overhead();
+    return dt > o ? dt - o : 0;
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace help {
+// Splits [0, n) into one contiguous chunk per hardware thread and runs
+// fn(begin, end) on each; ranges below grain stay on the calling thread.
+template<class Fn>
+void parallel_for(std::size_t n, Fn fn, std::size_t grain = std::size_t(1) << 16)
+{
+    std::size_t hw      = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t workers = std::min(hw, (n + grain - 1) / std::max<std::size_t>(grain, 1));
+    if (workers <= 1) {
+        fn(std::size_t(0), n);
+        return;
+    }
+
+    std::size_t chunk = (n + workers - 1) / workers;
+    std::vector<std::thread> pool;
+    for (std::size_t b = chunk; b < n; b += chunk)
+        pool.emplace_back(fn, b, std::min(n, b + chunk));
+    fn(std::size_t(0), chunk);
+    for (auto& t : pool) t.join();
+}
+}
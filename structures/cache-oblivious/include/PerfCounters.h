@@ -1,56 +1,201 @@
 #pragma once
 #include <linux/perf_event.h>
-#include <cstdint>         
-#include <sys/syscall.h>    
-#ifndef __NR_perf_event_open
-#endif
+#include <cstdint>
+#include <sys/syscall.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <cstring>
 #include <cerrno>
-#include <stdexcept>
 #include <array>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
+// Hardware counters of the calling thread, opened as a few small event
+// groups so every group is scheduled on the PMU as a whole and its events
+// are counted over the same interval. Each group is read in one go
+// together with time_enabled/time_running, and the counts are scaled up
+// when the kernel had to multiplex the groups. Events the host does not
+// have read as 0; the L2 and stall events fall back to raw Intel events
+// where the generic ones are missing. If perf_event_open is denied
+// altogether (perf_event_paranoid, containers) every counter reads 0 and
+// only the timings are meaningful.
 class PerfCounters {
-    int fd_refs_{-1}, fd_misses_{-1};
-    long long refs_{0}, misses_{0};
+public:
+    enum Event {
+        Cycles, Instructions, StalledCycles,
+        CacheRefs, CacheMisses,
+        L1Refs, L1Misses, L2Refs, L2Misses, L3Refs, L3Misses,
+        Branches, BranchMisses, DtlbMisses,
+        kEvents
+    };
+
+private:
+    struct Spec { std::uint32_t type; std::uint64_t config; };
+
+    struct Group {
+        int                 leader = -1;
+        std::vector<int>    fds;
+        std::vector<Event>  events;         // in read order
+    };
+
+    // At most four events per group, the general-purpose counters an SMT
+    // thread gets on current cores.
+    static constexpr std::array<std::array<int, 4>, 4> kGroups{{
+        {Cycles,    Instructions, Branches,   BranchMisses},
+        {CacheRefs, CacheMisses,  L3Refs,     L3Misses},
+        {L1Refs,    L1Misses,     DtlbMisses, StalledCycles},
+        {L2Refs,    L2Misses,     -1,         -1},
+    }};
+
+    std::vector<Group>              groups_;
+    std::array<long long, kEvents>  value_{};
+
+    static constexpr std::uint64_t cache(std::uint64_t id, std::uint64_t result) {
+        return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    }
 
-    static int openCounter(uint32_t type, uint64_t config)
+    static bool intel()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned a, b, c, d;
+        if (!__get_cpuid(0, &a, &b, &c, &d)) return false;
+        return b == 0x756e6547 && d == 0x49656e69 && c == 0x6c65746e;   // "GenuineIntel"
+#else
+        return false;
+#endif
+    }
+
+    // Encodings to try for an event, most portable first.
+    static std::vector<Spec> candidates(Event e)
+    {
+        switch (e) {
+        case Cycles:        return {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}};
+        case Instructions:  return {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}};
+        case CacheRefs:     return {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES}};
+        case CacheMisses:   return {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}};
+        case Branches:      return {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS}};
+        case BranchMisses:  return {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+        case L1Refs:   return {{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS)}};
+        case L1Misses: return {{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS)}};
+        case L3Refs:   return {{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL,  PERF_COUNT_HW_CACHE_RESULT_ACCESS)}};
+        case L3Misses: return {{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL,  PERF_COUNT_HW_CACHE_RESULT_MISS)}};
+        case DtlbMisses: return {{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS)}};
+        // The generic cache events have no L2; L2_RQSTS.REFERENCES/MISS
+        // (event 0x24) on Intel since Skylake.
+        case L2Refs:   if (intel()) return {{PERF_TYPE_RAW, 0xff24}}; return {};
+        case L2Misses: if (intel()) return {{PERF_TYPE_RAW, 0x3f24}}; return {};
+        // CYCLE_ACTIVITY.STALLS_TOTAL (0xa3, umask 0x04, cmask 4) where
+        // the generic backend stall event is not wired up.
+        case StalledCycles: {
+            std::vector<Spec> s{{PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND}};
+            if (intel()) s.push_back({PERF_TYPE_RAW, 0x04a3 | (std::uint64_t(4) << 24)});
+            return s;
+        }
+        default: return {};
+        }
+    }
+
+    static int open(const Spec& s, int group)
     {
         perf_event_attr pea{};
-        pea.type           = type;
-        pea.size           = sizeof(perf_event_attr);
-        pea.config         = config;
-        pea.inherit        = 0;       
-        pea.disabled       = 1;
+        pea.type           = s.type;
+        pea.size           = sizeof(pea);
+        pea.config         = s.config;
+        pea.disabled       = group == -1;   // members follow their leader
         pea.exclude_kernel = 0;
         pea.exclude_hv     = 1;
+        pea.read_format    = PERF_FORMAT_GROUP
+                           | PERF_FORMAT_TOTAL_TIME_ENABLED
+                           | PERF_FORMAT_TOTAL_TIME_RUNNING;
 
-        int fd = syscall(__NR_perf_event_open, &pea, 0, -1, -1, 0);
-        if (fd == -1)
-            throw std::runtime_error{"perf_event_open: " + std::string(strerror(errno))};
-        return fd;
+        return syscall(__NR_perf_event_open, &pea, 0, -1, group, 0);
     }
+
 public:
     PerfCounters()
     {
-        fd_refs_   = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
-        fd_misses_ = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
-    }
-    ~PerfCounters() { close(fd_refs_); close(fd_misses_); }
-
-    inline void start() const { ioctl(fd_refs_, PERF_EVENT_IOC_RESET, 0); ioctl(fd_misses_, PERF_EVENT_IOC_RESET, 0);
-                                ioctl(fd_refs_, PERF_EVENT_IOC_ENABLE, 0); ioctl(fd_misses_, PERF_EVENT_IOC_ENABLE, 0); }
-    inline void stop()
-{
-    ioctl(fd_refs_,   PERF_EVENT_IOC_DISABLE, 0);
-    ioctl(fd_misses_, PERF_EVENT_IOC_DISABLE, 0);
-
-    if (read(fd_refs_, &refs_, sizeof(refs_))   != sizeof(refs_))
-        throw std::runtime_error("failed to read cache-refs counter");
-    if (read(fd_misses_, &misses_, sizeof(misses_)) != sizeof(misses_))
-        throw std::runtime_error("failed to read cache-miss counter");
-}
-    long long refs()   const { return refs_;   }
-    long long misses() const { return misses_; }
+        int err = 0;
+        for (const auto& events : kGroups) {
+            Group g;
+            for (int e : events) {
+                if (e < 0) continue;
+                for (const Spec& s : candidates(Event(e))) {
+                    int fd = open(s, g.leader);
+                    if (fd == -1) { err = errno; continue; }
+                    if (g.leader == -1) g.leader = fd;
+                    g.fds.push_back(fd);
+                    g.events.push_back(Event(e));
+                    break;
+                }
+            }
+            if (g.leader != -1) groups_.push_back(std::move(g));
+        }
+
+        static std::atomic<bool> warned{false};
+        if (groups_.empty() && !warned.exchange(true)) {
+            std::cerr << "perf_event_open: " << std::strerror(err)
+                      << "; hardware counters disabled, reporting timings only\n";
+        }
+    }
+    ~PerfCounters()
+    {
+        for (const Group& g : groups_)
+            for (int fd : g.fds) close(fd);
+    }
+
+    PerfCounters(const PerfCounters&)            = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // False if no counter could be opened.
+    bool available() const { return !groups_.empty(); }
+
+    void start() const
+    {
+        for (const Group& g : groups_) {
+            ioctl(g.leader, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+            ioctl(g.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+    void stop()
+    {
+        for (const Group& g : groups_)
+            ioctl(g.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        value_.fill(0);
+        std::array<std::uint64_t, 3 + 4> buf;   // nr, enabled, running, values
+        for (const Group& g : groups_) {
+            const std::size_t want = (3 + g.fds.size()) * sizeof(std::uint64_t);
+            if (read(g.leader, buf.data(), want) != static_cast<ssize_t>(want)) continue;
+            const std::uint64_t enabled = buf[1], running = buf[2];
+            if (!running) continue;             // never got on the PMU
+            for (std::size_t i = 0; i < g.events.size() && i < buf[0]; ++i)
+                value_[g.events[i]] = static_cast<long long>(
+                    static_cast<double>(buf[3 + i]) * enabled / running);
+        }
+    }
+
+    long long cycles()         const { return value_[Cycles];        }
+    long long instructions()   const { return value_[Instructions];  }
+    long long stalled_cycles() const { return value_[StalledCycles]; }
+
+    long long refs()  const { return value_[CacheRefs];   }
+    long long misses()const { return value_[CacheMisses]; }
+
+    long long l1_refs()   const { return value_[L1Refs];   }
+    long long l1_misses() const { return value_[L1Misses]; }
+
+    long long l2_refs()   const { return value_[L2Refs];   }
+    long long l2_misses() const { return value_[L2Misses]; }
+
+    long long l3_refs()   const { return value_[L3Refs];   }
+    long long l3_misses() const { return value_[L3Misses]; }
+
+    long long branches()       const { return value_[Branches];     }
+    long long branch_misses()  const { return value_[BranchMisses]; }
+
+    long long dtlb_misses()    const { return value_[DtlbMisses]; }
 };
@@ -0,0 +1,213 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Key streams for the benchmarks. The inserts are n draws from [1, 10n];
+// they and the lookups follow the Spec:
+//
+//   key_dist   uniform, or lognormal: exp(N(0, key_sigma)) = x squashed to
+//              x / (1 + x) of the range, dense at both ends and sparse in
+//              the middle (a hard case for models of the key distribution)
+//   dist       uniform, or zipf with exponent zipf_s over a fixed random
+//              permutation of the candidates (so the hot keys are spread
+//              over the key space)
+//   hit_ratio  if in [0, 1], exactly round(hit_ratio * q) lookups are
+//              inserted keys and the rest are absent ones; otherwise the
+//              lookups are drawn like the inserts (~10% hits)
+//   order      random, sorted, or nearly_sorted: sorted, then a disorder
+//              fraction of the positions swapped with one at most window
+//              positions away
+//   trace      a file with one key per line replayed as the lookups, in
+//              order and cycled up to q; it replaces dist and hit_ratio
+//
+// Draws happen on integers and are mapped onto the key type afterwards by
+// an injective makeKey, so hits stay hits for every key type. The default
+// Spec reproduces the plain uniform stream exactly.
+namespace workload {
+
+struct Spec {
+    std::string key_dist  = "uniform";
+    double      key_sigma = 1.5;
+    std::string dist      = "uniform";
+    double      zipf_s    = 0.99;
+    double      hit_ratio = -1;
+    std::string order     = "random";
+    double      disorder  = 0.01;
+    std::size_t window    = 64;
+    std::string trace;
+};
+
+// Empty if the spec is usable, otherwise what is wrong with it.
+inline std::string check(const Spec& s)
+{
+    if (s.key_dist != "uniform" && s.key_dist != "lognormal") return "Unknown key_dist " + s.key_dist;
+    if (s.key_dist == "lognormal" && !(s.key_sigma > 0))     return "key_sigma must be > 0";
+    if (s.dist != "uniform" && s.dist != "zipf")  return "Unknown dist " + s.dist;
+    if (s.dist == "zipf" && !(s.zipf_s > 0))      return "zipf_s must be > 0";
+    if (s.order != "random" && s.order != "sorted" && s.order != "nearly_sorted")
+        return "Unknown order " + s.order;
+    if (s.hit_ratio > 1)                          return "hit_ratio must be <= 1";
+    return {};
+}
+
+// Zipf(s) on {1, ..., N} by rejection-inversion (Hörmann and Derflinger,
+// 1996): O(1) memory and expected time per draw for any N and s > 0.
+class Zipf {
+    double        s_, hx1_, hn_, t_;
+    std::uint64_t n_;
+
+    double h(double x) const { return std::exp(-s_ * std::log(x)); }
+
+    static double helper1(double x) { return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0/3 - 0.25 * x)); }
+    static double helper2(double x) { return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x)); }
+
+    double H(double x) const {
+        double lx = std::log(x);
+        return helper2((1 - s_) * lx) * lx;
+    }
+    double Hinv(double x) const {
+        double t = std::max(-1.0, x * (1 - s_));
+        return std::exp(helper1(t) * x);
+    }
+
+public:
+    Zipf(std::uint64_t n, double s)
+        : s_(s), hx1_(H(1.5) - 1), hn_(H(double(n) + 0.5)),
+          t_(2 - Hinv(H(2.5) - h(2))), n_(n) {}
+
+    template<class Rng>
+    std::uint64_t operator()(Rng& rng) const
+    {
+        std::uniform_real_distribution<double> u01(0.0, 1.0);
+        for (;;) {
+            double u = hn_ + u01(rng) * (hx1_ - hn_);
+            double x = Hinv(u);
+            std::uint64_t k = std::clamp<std::uint64_t>(std::uint64_t(x + 0.5), 1, n_);
+            if (double(k) - x <= t_ || u >= H(double(k) + 0.5) - h(double(k))) return k;
+        }
+    }
+};
+
+// r -> r * c mod m with gcd(c, m) = 1 is a bijection on [0, m); it stands
+// in for a random permutation that would not fit in memory for m = 10n.
+class Scatter {
+    std::uint64_t m_, c_;
+public:
+    Scatter(std::uint64_t m, std::mt19937& rng) : m_(std::max<std::uint64_t>(m, 1))
+    {
+        c_ = m_ / 2 + rng() % std::max<std::uint64_t>(m_ / 2, 1);
+        while (std::gcd(c_, m_) != 1) ++c_;
+    }
+    std::uint64_t operator()(std::uint64_t r) const {
+        return static_cast<std::uint64_t>((unsigned __int128)(r % m_) * c_ % m_);
+    }
+};
+
+template<class Key>
+struct Stream {
+    std::vector<Key> inserts, lookups;
+};
+
+template<class Key, class Parse>
+std::vector<Key> readTrace(const std::string& path, std::size_t q, Parse parse)
+{
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open trace " + path);
+    std::vector<Key> keys;
+    for (std::string line; std::getline(in, line); )
+        if (!line.empty()) keys.push_back(parse(line));
+    if (keys.empty()) throw std::runtime_error("empty trace " + path);
+
+    std::vector<Key> out(q);
+    for (std::size_t i = 0; i < q; ++i) out[i] = keys[i % keys.size()];
+    return out;
+}
+
+// makeKey maps a draw in [1, 10n] onto Key, parse a trace line; less
+// orders the sorted streams.
+template<class Key, class MakeKey, class Parse, class Less = std::less<Key>>
+Stream<Key> generate(const Spec& spec, std::size_t n, std::size_t q, unsigned seed,
+                     MakeKey makeKey, Parse parse, Less less = {})
+{
+    std::mt19937 rng(seed);
+    const std::uint64_t universe = std::max<std::size_t>(n, 1) * 10;
+    std::uniform_int_distribution<int> uniform(1, static_cast<int>(universe));
+    std::lognormal_distribution<double> lognormal(0.0, spec.key_sigma);
+    auto dist = [&](std::mt19937& r) -> std::uint64_t {
+        if (spec.key_dist == "uniform") return uniform(r);
+        const double x = lognormal(r);
+        return 1 + std::min(universe - 1, std::uint64_t(double(universe - 1) * (x / (1 + x))));
+    };
+
+    std::vector<std::uint64_t> ins(n);
+    for (auto& x : ins) x = dist(rng);
+
+    Stream<Key> out;
+    out.inserts.resize(n);
+    std::transform(ins.begin(), ins.end(), out.inserts.begin(), makeKey);
+
+    std::vector<std::uint64_t> look(q);
+    const bool zipf = spec.dist == "zipf";
+    if (!spec.trace.empty()) {
+        out.lookups = readTrace<Key>(spec.trace, q, parse);
+    } else if (spec.hit_ratio < 0) {
+        if (!zipf) {
+            for (auto& x : look) x = dist(rng);
+        } else {
+            Zipf z(universe, spec.zipf_s);
+            Scatter perm(universe, rng);
+            for (auto& x : look) x = 1 + perm(z(rng) - 1);
+        }
+    } else {
+        std::sort(ins.begin(), ins.end());
+        ins.erase(std::unique(ins.begin(), ins.end()), ins.end());
+        auto present = [&](std::uint64_t v) { return std::binary_search(ins.begin(), ins.end(), v); };
+
+        // exactly H hits at random positions
+        const std::size_t H = ins.empty() ? 0 : std::size_t(std::llround(spec.hit_ratio * q));
+        std::vector<bool> hit(q, false);
+        std::fill_n(hit.begin(), H, true);
+        std::shuffle(hit.begin(), hit.end(), rng);
+
+        Zipf zh(std::max<std::size_t>(ins.size(), 1), zipf ? spec.zipf_s : 1.0);
+        Zipf zm(universe, zipf ? spec.zipf_s : 1.0);
+        Scatter ph(ins.size(), rng), pm(universe, rng);
+        std::uniform_int_distribution<std::size_t> any(0, std::max<std::size_t>(ins.size(), 1) - 1);
+
+        for (std::size_t i = 0; i < q; ++i) {
+            if (hit[i]) {
+                look[i] = ins[zipf ? ph(zh(rng) - 1) : any(rng)];
+            } else {
+                do look[i] = zipf ? 1 + pm(zm(rng) - 1) : dist(rng);
+                while (present(look[i]));
+            }
+        }
+    }
+    if (spec.trace.empty()) {
+        out.lookups.resize(q);
+        std::transform(look.begin(), look.end(), out.lookups.begin(), makeKey);
+    }
+
+    if (spec.order != "random") {
+        std::sort(out.lookups.begin(), out.lookups.end(), less);
+        if (spec.order == "nearly_sorted" && q > 1) {
+            const std::size_t swaps = std::size_t(std::llround(spec.disorder * q));
+            std::uniform_int_distribution<std::size_t> at(0, q - 1), off(1, std::max<std::size_t>(spec.window, 1));
+            for (std::size_t i = 0; i < swaps; ++i) {
+                std::size_t a = at(rng), b = std::min(q - 1, a + off(rng));
+                std::swap(out.lookups[a], out.lookups[b]);
+            }
+        }
+    }
+    return out;
+}
+
+}
@@ -2,7 +2,7 @@
 
 make
 
-IMPLS=("BST_PTR" "BST_VEB")    
+IMPLS=("BST_PTR" "BST_PTR_BFS" "BST_VEB" "BST_PRE" "BST_PMA")    
 
 for impl in "${IMPLS[@]}"; do
   ./bst-bench "$1" "$impl"
@@ -1,7 +1,12 @@
 #include "IBST.h"
 #include "BSTPtr.h"
 #include "BSTVEB.h"
+#include "BSTPreorder.h"
+#include "BSTPma.h"
 #include "PerfCounters.h"
+#include "LatencyHistogram.h"
+#include "Workload.h"
+#include "MemoryUsage.h"
 
 #include <vector>
 #include <random>
@@ -9,8 +14,11 @@
 #include <iomanip>
 #include <fstream>
 #include "util/json.hpp"
-#include <functional>
+#include <tuple>
+#include <memory>
 #include <chrono>
+#include <array>
+#include <cmath>
 
 using json  = nlohmann::json;
 using Clock = std::chrono::steady_clock;
@@ -20,65 +28,101 @@ struct Metrics {
     long long ops         = 0;
     long long cache_refs  = 0;
     long long cache_miss  = 0;
+    long long peak_bytes  = 0;   // resident memory the inserts and freeze added at their peak
 };
 
+// Keeps a result alive once the lookups are inlined into the timed loop.
+template<class T>
+inline void keep(const T& v) { asm volatile("" : : "g"(v) : "memory"); }
+
+// Runs after the inserts and before the clock starts: the static layouts
+// are built and BST_PTR_BFS renumbers its nodes in breadth-first order.
+template<class Tree>
+void prepare(Tree& tree) {
+    if constexpr (requires { tree.build(); }) tree.build();
+}
+
 template<class Key>
-Metrics benchOnce(IBST<Key>& tree,
+void prepare(BSTPtr<Key, true>& tree) { tree.compact(); }
+
+// Instantiated per concrete tree; the qualified calls dispatch statically
+// so the timed loop measures the descent and not the vtable. With a
+// histogram every sample-th lookup is afterwards timed on its own.
+template<class Tree, class Key>
+Metrics benchOnce(Tree& tree,
                   const std::vector<Key>& lookups,
-                  const std::vector<Key>& inserts)
+                  const std::vector<Key>& inserts,
+                  latency::Histogram* lat = nullptr, std::size_t sample = 0)
 {
-    for (const auto& k : inserts) tree.insert(k);
+    const bool        tracked = help::resetPeakResident();
+    const std::size_t rss0    = tracked ? help::residentBytes() : 0;
+    for (const auto& k : inserts) tree.Tree::insert(k);
+    prepare(tree);
 
+    std::size_t found = 0;
     PerfCounters pc;
     pc.start();
 
     auto start = Clock::now();
     for (const auto& k : lookups)
-        (void)tree.contains(k);
+        found += tree.Tree::contains(k);
     auto end   = Clock::now();
 
     pc.stop();
+    keep(found);
+    const std::size_t peak = tracked ? help::peakResidentBytes() : 0;
+
+    if (lat)
+        for (std::size_t i = 0; i < lookups.size(); i += sample)
+            lat->record(latency::measure([&] { bool r = tree.Tree::contains(lookups[i]); keep(r); }));
 
     Metrics m;
     m.ns         = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
     m.ops        = lookups.size();
     m.cache_refs = pc.refs();
     m.cache_miss = pc.misses();
+    m.peak_bytes = peak > rss0 ? peak - rss0 : 0;
     return m;
 }
 
-using Factory = std::function<std::unique_ptr<IBST<int>>(void)>;
-struct Variant { std::string name; Factory make; };
+template<class Tree>
+struct Impl { const char* name; };
 
-const std::vector<Variant> variants = {
-    {"BST_PTR", [] { return std::make_unique<BSTPtr<int>>(); }},
-    {"BST_VEB", [] { return std::make_unique<BSTVEB<int>>(); }},
+const auto registry = std::tuple{
+    Impl<BSTPtr<int>>{"BST_PTR"},
+    Impl<BSTPtr<int, true>>{"BST_PTR_BFS"},
+    Impl<BSTVEB<int>>{"BST_VEB"},
+    Impl<BSTPreorder<int>>{"BST_PRE"},
+    Impl<BSTPma<int>>{"BST_PMA"},
 };
 
+// Sets that also erase, for the mixed mode.
+const auto dynamicRegistry = std::tuple{
+    Impl<BSTPma<int>>{"BST_PMA"},
+};
+
+template<class Tree>
 void runExperiment(int n, int q, int T, bool csv,
-                   const Factory& make, unsigned seed,
-                   const std::string& impl)
+                   const workload::Stream<int>& w, const std::string& impl,
+                   std::size_t latency_sample)
 {
-    std::mt19937 rng(seed);
-    std::uniform_int_distribution<int> dist(1, n * 10);
-
-    std::vector<int> inserts(n);
-    for (int& x : inserts) x = dist(rng);
-
-    std::vector<int> lookups(q);
-    for (int& x : lookups) x = dist(rng);
+    const std::vector<int>& inserts = w.inserts;
+    const std::vector<int>& lookups = w.lookups;
 
     long long  acc_ns   = 0;
     long long  acc_refs = 0, acc_miss = 0;
-    std::size_t bytes_used = 0;
+    std::size_t bytes_used = 0, peak_bytes = 0;
+    latency::Histogram lat;
 
     for (int t = 0; t < T; ++t) {
-        auto tree = make();
-        Metrics m = benchOnce(*tree, lookups, inserts);
+        auto tree = std::make_unique<Tree>();
+        Metrics m = benchOnce(*tree, lookups, inserts,
+                              latency_sample ? &lat : nullptr, latency_sample);
         acc_ns   += m.ns;
         acc_refs += m.cache_refs;
         acc_miss += m.cache_miss;
         if (t == 0) bytes_used = tree->size_bytes();  
+        peak_bytes = std::max<std::size_t>(peak_bytes, m.peak_bytes);
     }
 
     double avg_ns      = double(acc_ns)   / T;
@@ -91,6 +135,15 @@ void runExperiment(int n, int q, int T, bool csv,
     double avg_s       = avg_ns / 1e9;
     double bytes_mb    = bytes_used / 1024.0 / 1024.0;
 
+    // p50, p90, p99, p99.9 and max of the sampled lookups in ns
+    std::array<double, 5> tail{};
+    if (latency_sample) {
+        const double tpn = latency::ticksPerNs();
+        const double ps[] = {0.5, 0.9, 0.99, 0.999};
+        for (int i = 0; i < 4; ++i) tail[i] = lat.percentile(ps[i]) / tpn;
+        tail[4] = lat.max() / tpn;
+    }
+
     if (csv) {
         std::cout << impl << ','
                   << n << ',' << q << ','
@@ -102,11 +155,14 @@ void runExperiment(int n, int q, int T, bool csv,
                   << avg_refs << ',' << avg_miss << ','
                   << miss_per_op << ','
                   << miss_rate << ','
-                  << bytes_used  << '\n';
+                  << bytes_used << ',' << peak_bytes;
+        if (latency_sample)
+            for (double v : tail) std::cout << ',' << std::llround(v);
+        std::cout << '\n';
     } else {
         std::cout << std::fixed << std::setprecision(2)
                   << std::left
-                  << std::setw(10) << impl
+                  << std::setw(12) << impl
                   << std::setw(10) << n
                   << std::setw(10) << q
                   << std::setw(15) << avg_ns
@@ -118,6 +174,94 @@ void runExperiment(int n, int q, int T, bool csv,
                   << std::setw(12) << miss_per_op
                   << std::setw(10) << std::fixed << std::setprecision(3) << miss_rate
                   << std::setw(12) << std::fixed << std::setprecision(1) << bytes_mb
+                  << std::setw(10) << peak_bytes / 1024.0 / 1024.0;
+        if (latency_sample)
+            for (double v : tail) std::cout << std::setw(10) << std::setprecision(0) << v;
+        std::cout << '\n';
+    }
+}
+
+// Mixed mode: the n inserts are loaded, then q operations run in rounds of
+// kRound, write_frac of them writes (a new key, or with delete_frac an
+// erase of an inserted one) followed by lookups. Writes and reads are timed
+// per block, so ns/write includes the amortised rebalances and ns/read the
+// layout they leave behind; moves/write is the keys a rebalance rewrote.
+template<class Tree>
+void runMixed(int n, int q, int T, bool csv, unsigned seed,
+              double write_frac, double delete_frac,
+              const workload::Stream<int>& w, const std::string& impl)
+{
+    constexpr std::size_t kRound = 1024;
+
+    const std::vector<int>& inserts = w.inserts;
+    const std::vector<int>& lookups = w.lookups;
+
+    const std::size_t W = std::min<std::size_t>(kRound, std::llround(kRound * write_frac));
+    const std::size_t R = kRound - W;
+    const std::size_t rounds = (static_cast<std::size_t>(q) + kRound - 1) / kRound;
+
+    std::mt19937 rng(seed + 1);
+    std::uniform_int_distribution<int> dist(1, n * 10);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::vector<std::pair<int, bool>> writes(rounds * W);    // (key, erase)
+    for (auto& wr : writes) {
+        bool erase = !inserts.empty() && coin(rng) < delete_frac;
+        wr = {erase ? inserts[rng() % inserts.size()] : dist(rng), erase};
+    }
+
+    long long acc_w = 0, acc_r = 0;
+    std::uint64_t moves = 0;
+    std::size_t reads = 0;       // lookups run per repetition; the last round may be short
+    std::size_t bytes_used = 0;
+    for (int t = 0; t < T; ++t) {
+        auto tree = std::make_unique<Tree>();
+        for (const auto& k : inserts) tree->Tree::insert(k);
+        const std::uint64_t moved0 = tree->moved();
+        std::size_t found = 0, next_read = 0;
+
+        for (std::size_t r = 0; r < rounds; ++r) {
+            auto t0 = Clock::now();
+            for (std::size_t i = r * W; i < (r + 1) * W; ++i) {
+                if (writes[i].second) tree->Tree::erase(writes[i].first);
+                else                  tree->Tree::insert(writes[i].first);
+            }
+            auto t1 = Clock::now();
+            const std::size_t m = std::min(R, lookups.size() - next_read);
+            for (std::size_t i = next_read; i < next_read + m; ++i) found += tree->Tree::contains(lookups[i]);
+            auto t2 = Clock::now();
+            next_read = (next_read + m) % std::max<std::size_t>(lookups.size(), 1);
+            if (t == 0) reads += m;
+
+            acc_w += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            acc_r += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        }
+        keep(found);
+        moves += tree->moved() - moved0;
+        if (t == 0) bytes_used = tree->size_bytes();
+    }
+
+    const double writes_total = double(rounds * W) * T;
+    const double reads_total  = double(reads) * T;
+    const double ns_write  = writes_total ? acc_w / writes_total : 0.0;
+    const double ns_read   = reads_total  ? acc_r / reads_total  : 0.0;
+    const double mv_write  = writes_total ? moves / writes_total : 0.0;
+
+    if (csv) {
+        std::cout << impl << ',' << n << ',' << q << ','
+                  << rounds * W << ',' << reads << ','
+                  << ns_write << ',' << ns_read << ',' << mv_write << ','
+                  << bytes_used << '\n';
+    } else {
+        std::cout << std::left << std::fixed << std::setprecision(2)
+                  << std::setw(12) << impl
+                  << std::setw(10) << n
+                  << std::setw(10) << q
+                  << std::setw(10) << rounds * W
+                  << std::setw(10) << reads
+                  << std::setw(12) << ns_write
+                  << std::setw(12) << ns_read
+                  << std::setw(12) << mv_write
+                  << std::setw(10) << std::setprecision(1) << bytes_used / 1024.0 / 1024.0
                   << '\n';
     }
 }
@@ -130,6 +274,10 @@ int main(int argc, char* argv[])
     bool        csv  = false;
     unsigned    seed = 42;
     std::string impl = "ALL";
+    std::size_t latency_sample = 0;     // > 0: also time every k-th lookup on its own
+    double      write_frac  = 0;        // > 0: mixed insert/erase/lookup mode
+    double      delete_frac = 0.5;
+    workload::Spec spec;                // lookup distribution, hit ratio, order, trace
 
     if (argc >= 2) {
         std::ifstream in(argv[1]);
@@ -141,13 +289,54 @@ int main(int argc, char* argv[])
         if (cfg.contains("csv"))  csv  = cfg["csv"];
         if (cfg.contains("seed")) seed = cfg["seed"];
         if (cfg.contains("impl")) impl = cfg["impl"];
+        if (cfg.contains("latency_sample")) latency_sample = cfg["latency_sample"];
+        if (cfg.contains("write_frac"))  write_frac  = cfg["write_frac"];
+        if (cfg.contains("delete_frac")) delete_frac = cfg["delete_frac"];
+        if (cfg.contains("key_dist"))  spec.key_dist  = cfg["key_dist"];
+        if (cfg.contains("key_sigma")) spec.key_sigma = cfg["key_sigma"];
+        if (cfg.contains("dist"))      spec.dist      = cfg["dist"];
+        if (cfg.contains("zipf_s"))    spec.zipf_s    = cfg["zipf_s"];
+        if (cfg.contains("hit_ratio")) spec.hit_ratio = cfg["hit_ratio"];
+        if (cfg.contains("order"))     spec.order     = cfg["order"];
+        if (cfg.contains("disorder"))  spec.disorder  = cfg["disorder"];
+        if (cfg.contains("window"))    spec.window    = cfg["window"];
+        if (cfg.contains("trace"))     spec.trace     = cfg["trace"];
     }
+    if (auto err = workload::check(spec); !err.empty()) { std::cerr << err << '\n'; return 1; }
 
     if (argc == 3) impl = argv[2];
 
+    // one stream for all implementations
+    const auto stream = workload::generate<int>(spec, n, q, seed,
+        [](std::uint64_t v) { return static_cast<int>(v); },
+        [](const std::string& s) { return std::stoi(s); });
+
+    if (write_frac > 0) {
+        if (csv)
+            std::cout << "impl,n,q,writes,reads,ns_per_write,ns_per_read,moves_per_write,bytes\n";
+        else
+            std::cout << std::left
+                      << std::setw(12) << "impl"
+                      << std::setw(10) << "n"
+                      << std::setw(10) << "q"
+                      << std::setw(10) << "writes"
+                      << std::setw(10) << "reads"
+                      << std::setw(12) << "ns/write"
+                      << std::setw(12) << "ns/read"
+                      << std::setw(12) << "moves/write"
+                      << std::setw(10) << "bytes(MB)" << '\n'
+                      << std::string(98, '-') << '\n';
+        auto mixed = [&]<class Tree>(Impl<Tree> v) {
+            if (impl != "ALL" && impl != v.name) return;
+            runMixed<Tree>(n, q, T, csv, seed, write_frac, delete_frac, stream, v.name);
+        };
+        std::apply([&](auto... v) { (mixed(v), ...); }, dynamicRegistry);
+        return 0;
+    }
+
     if (!csv) {
         std::cout << std::left
-                  << std::setw(10) << "impl"
+                  << std::setw(12) << "impl"
                   << std::setw(10) << "n"
                   << std::setw(10) << "q"
                   << std::setw(15) << "total_ns"
@@ -157,16 +346,24 @@ int main(int argc, char* argv[])
                   << std::setw(15) << "cache_miss"
                   << std::setw(12) << "miss/search"
                   << std::setw(10) << "missRate"
-                  << std::setw(12) << "bytes(MB)" << '\n'
-                  << std::string(134, '-') << '\n';
+                  << std::setw(12) << "bytes(MB)"
+                  << std::setw(10) << "peak(MB)";
+        if (latency_sample)
+            for (const char* h : {"p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns"})
+                std::cout << std::setw(10) << h;
+        std::cout << '\n'
+                  << std::string(latency_sample ? 196 : 146, '-') << '\n';
     } else {
         std::cout << "impl,n,q,total_ns,total_s,ns_per_search,"
-                     "cache_refs,cache_misses,misses_per_search,miss_rate,bytes\n";
+                     "cache_refs,cache_misses,misses_per_search,miss_rate,bytes,peak_bytes";
+        if (latency_sample) std::cout << ",p50_ns,p90_ns,p99_ns,p999_ns,max_ns";
+        std::cout << '\n';
     }
 
-    for (const auto& v : variants) {
-        if (impl != "ALL" && impl != v.name) continue;
-        runExperiment(n, q, T, csv, v.make, seed, v.name);
-    }
+    auto run = [&]<class Tree>(Impl<Tree> v) {
+        if (impl != "ALL" && impl != v.name) return;
+        runExperiment<Tree>(n, q, T, csv, stream, v.name, latency_sample);
+    };
+    std::apply([&](auto... v) { (run(v), ...); }, registry);
     return 0;
 }
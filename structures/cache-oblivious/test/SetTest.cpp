@@ -0,0 +1,185 @@
+#include <cassert>
+#include <vector>
+#include <iostream>
+
+#include "../include/BSTPma.h"
+#include "../include/BSTPtr.h"
+#include "../include/BSTVEB.h"
+#include "../include/BSTPreorder.h"
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <set>
+#include <random>
+#include <stdexcept>
+
+// Every key in [lo, hi] and ranges of a few widths answer as in ref.
+void pma_same(const BSTPma<int>& t, const std::set<int>& ref, int lo, int hi)
+{
+    assert(t.size() == ref.size() && "pma size");
+    for (int x = lo; x <= hi; ++x)
+        assert(t.contains(x) == (ref.count(x) == 1) && "pma contains");
+
+    for (int width : {1, 17, 300, hi - lo + 2}) {
+        for (int a = lo; a <= hi; a += 1 + (hi - lo) / 50) {
+            std::vector<int> got;
+            std::size_t c = t.range(a, a + width, [&](int k) { got.push_back(k); });
+            std::vector<int> want(ref.lower_bound(a), ref.lower_bound(a + width));
+            assert(c == got.size() && "pma range count");
+            assert(got == want && "pma range keys");
+        }
+    }
+}
+
+// Random inserts and erases over a small key range, so segments fill,
+// rebalance, empty and the array is resized both ways.
+void pma_check(std::size_t ops = 100'000)
+{
+    BSTPma<int> t;
+    std::set<int> ref;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> key(0, 4'000);
+
+    for (std::size_t i = 0; i < ops; ++i) {
+        int k = key(rng);
+        // mostly inserts in the first half, mostly erases in the second
+        if (rng() % 4 < (i < ops / 2 ? 1u : 3u)) {
+            assert(t.erase(k) == (ref.erase(k) == 1) && "pma erase");
+        } else {
+            t.insert(k);
+            ref.insert(k);
+        }
+        assert(t.size() == ref.size() && "pma size");
+        if (i % 9'973 == 0) pma_same(t, ref, -1, 4'001);
+    }
+    pma_same(t, ref, -1, 4'001);
+}
+
+// Ascending and descending inserts, which always hit the last or first
+// segment, then erasing every key in random order down to an empty set,
+// which takes inserts again.
+void pma_sorted_check(std::size_t N = 50'000)
+{
+    for (bool ascending : {true, false}) {
+        BSTPma<int> t;
+        std::set<int> ref;
+        for (std::size_t i = 0; i < N; ++i) {
+            int k = static_cast<int>(ascending ? i * 2 : (N - i) * 2);
+            t.insert(k);
+            ref.insert(k);
+        }
+        t.insert(ascending ? 0 : static_cast<int>(N * 2));   // duplicate
+        pma_same(t, ref, -1, static_cast<int>(N * 2) + 1);
+
+        std::vector<int> order(ref.begin(), ref.end());
+        std::shuffle(order.begin(), order.end(), std::mt19937(11));
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            assert(t.erase(order[i]) && "pma erase present");
+            assert(!t.erase(order[i]) && "pma erase twice");
+            ref.erase(order[i]);
+            if (i % 4'999 == 0) pma_same(t, ref, -1, static_cast<int>(N * 2) + 1);
+        }
+        assert(t.size() == 0 && "pma not empty");
+        assert(t.capacity() <= 16 && "pma did not shrink");
+        assert(t.range(-1, static_cast<int>(N * 2) + 2, [](int) {}) == 0 && "pma empty range");
+        pma_same(t, ref, -1, 100);
+
+        for (int k : {5, 3, 9}) { t.insert(k); ref.insert(k); }
+        pma_same(t, ref, -1, 10);
+    }
+}
+
+// Sorted, reverse-sorted and random inserts, duplicates included, keep the
+// AVL height bound and answer as std::set.
+void ptr_check(std::size_t N = 100'000)
+{
+    for (int order = 0; order < 3; ++order) {
+        std::vector<int> keys;
+        for (std::size_t i = 0; i < N; ++i) keys.push_back(static_cast<int>(i * 2));
+        if (order == 1) std::reverse(keys.begin(), keys.end());
+        if (order == 2) {
+            std::shuffle(keys.begin(), keys.end(), std::mt19937(5));
+            keys.insert(keys.end(), keys.begin(), keys.begin() + N / 10);
+        }
+
+        BSTPtr<int> t;
+        std::set<int> ref;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            t.insert(keys[i]);
+            ref.insert(keys[i]);
+            const std::size_t n = ref.size();
+            if ((i & (i + 1)) == 0 || i + 1 == keys.size())
+                assert(t.tree_height() <= 1.44 * std::log2(double(n) + 2) && "ptr height bound");
+        }
+        assert(t.size() == ref.size() && "ptr size");
+        for (int x = -1; x <= static_cast<int>(N * 2); ++x)
+            assert(t.contains(x) == (ref.count(x) == 1) && "ptr contains");
+    }
+}
+
+// The breadth-first renumbering keeps the tree: compacted after every
+// round of inserts, it answers as the plain one both right after and
+// after the next round.
+void ptr_compact_check(std::size_t N = 50'000)
+{
+    BSTPtr<int> plain;
+    BSTPtr<int, true> bfs;
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> key(0, static_cast<int>(N * 4));
+    const int hi = static_cast<int>(N * 4) + 1;
+
+    auto same = [&] {
+        for (int x = -1; x <= hi; ++x)
+            assert(bfs.contains(x) == plain.contains(x) && "ptr bfs contains");
+        assert(bfs.size() == plain.size() && "ptr bfs size");
+        assert(bfs.tree_height() == plain.tree_height() && "ptr bfs height");
+    };
+    for (int round = 0; round < 4; ++round) {
+        for (std::size_t i = 0; i < N; ++i) {
+            int k = key(rng);
+            plain.insert(k);
+            bfs.insert(k);
+        }
+        same();          // the inserts since the last compact() included
+        bfs.compact();
+        same();
+    }
+}
+
+// The static layouts answer from what build() laid out, for sizes around
+// the parallel cut of the vEB layout too, and refuse later inserts.
+template<class Tree>
+void static_check()
+{
+    for (std::size_t N : {0, 1, 2, 7, 100, 1'024, 70'000, 131'073}) {
+        Tree t;
+        std::set<int> ref;
+        for (std::size_t i = 0; i < N; ++i) {
+            int k = static_cast<int>((i * 7919) % N * 2);
+            t.insert(k);
+            t.insert(k);
+            ref.insert(k);
+        }
+        t.build();
+        assert(t.size_bytes() == ref.size() * sizeof(int) && "static size");
+        for (int x = -1; x <= static_cast<int>(N * 2); ++x)
+            assert(t.contains(x) == (ref.count(x) == 1) && "static contains");
+
+        bool threw = false;
+        try { t.insert(1); } catch (const std::logic_error&) { threw = true; }
+        assert(threw && "static insert after build");
+    }
+}
+
+int main()
+{
+    pma_check();
+    pma_sorted_check();
+    ptr_check();
+    ptr_compact_check();
+    static_check< BSTVEB<int>      >();
+    static_check< BSTPreorder<int> >();
+
+    std::cout << "all set tests passed\n";
+    return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+template<class T, std::size_t Align = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template<class U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template<class U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        std::size_t bytes = (n * sizeof(T) + Align - 1) / Align * Align;
+        void* p = std::aligned_alloc(Align, bytes ? bytes : Align);
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, std::size_t) noexcept { std::free(p); }
+
+    template<class U>
+    bool operator==(const AlignedAllocator<U, Align>&) const noexcept { return true; }
+};
@@ -1,62 +1,349 @@
 #pragma once
 #include "IBST.h"
+#include "KeyTraits.h"
+#include "Parallel.h"
+#include "IndexFile.h"
+#include "RadixSort.h"
+#include "InPlaceLayout.h"
+#include "Prefetch.h"
 #include <vector>
+#include <memory>
 #include <algorithm>
-#include <stdexcept>
+#include <bit>
+#include <span>
+#include <optional>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
 
-template<class Key>
+// Multiset keeps one node per distinct key plus the number of copies that
+// were inserted, so rank and count_range count duplicates. SortedSet
+// promises keys that are already sorted and unique and skips the sort.
+enum class KeyMode { Set, Multiset, SortedSet };
+
+template<class Key, class Alloc = std::allocator<Key>>
 class BSTEyt : public IBST<Key> {
 protected:  
-    std::vector<Key> arr_; 
-    static void dedupSort(std::vector<Key>& v) {
-        std::sort(v.begin(), v.end());
-        v.erase(std::unique(v.begin(), v.end()), v.end());
+    using Tr = KeyTraits<Key>;
+
+    using Array = std::vector<Key, Alloc>;
+
+    Array            arr_; 
+    unsigned         levels_ = 0;   // complete levels: bit_width(n+1) - 1
+
+    // Set when the tree was opened from an index file; the keys then live
+    // in the mapping and arr_ stays empty.
+    std::shared_ptr<const index_file::Mapping> map_;
+    std::span<const Key>                       mapped_;
+
+    // Multiset mode only: copies of all keys with in-order rank < r, for
+    // r = 0..n. Empty in set mode, where that count is r itself.
+    std::vector<std::uint64_t>                 below_;
+
+    std::span<const Key> keys() const {
+        return map_ ? mapped_ : std::span<const Key>(arr_);
+    }
+    static void dedupSort(std::vector<Key>& v, bool inPlace = false) {
+        help::sortUnique(v, KeyLess<Key>{}, KeyEqual<Key>{}, inPlace);
+    }
+
+    // dedupSort that records the run lengths in below_ as prefix sums.
+    void dedupSortCounted(std::vector<Key>& v, bool inPlace = false) {
+        help::sortKeys(v, KeyLess<Key>{}, inPlace);
+        below_.assign(1, 0);
+        std::size_t out = 0;
+        for (std::size_t i = 0; i < v.size(); ++out) {
+            std::size_t j = i + 1;
+            while (j < v.size() && Tr::equal(v[j], v[i])) ++j;
+            v[out] = v[i];
+            below_.push_back(below_.back() + (j - i));
+            i = j;
+        }
+        v.resize(out);
+    }
+
+    // In-order rank of the 0-based slot s in an Eytzinger tree of n nodes:
+    // its rank in the perfect tree of the same height, minus the leaves of
+    // the partial last level that are missing to its left.
+    static std::size_t inorderRank(std::size_t s, std::size_t n)
+    {
+        const std::size_t k = s + 1;
+        const unsigned    H = std::bit_width(n);
+        const unsigned    d = std::bit_width(k) - 1;
+
+        std::size_t r      = ((2*(k - (std::size_t(1) << d)) + 1) << (H - 1 - d)) - 1;
+        std::size_t leaves = n - ((std::size_t(1) << (H - 1)) - 1);
+        std::size_t before = (r + 1) / 2;
+        return r - (before > leaves ? before - leaves : 0);
+    }
+
+    // Every slot knows its source, so the layout is one parallel gather.
+    void buildEyt(const std::vector<Key>& sorted)
+    {
+        const std::size_t n = sorted.size();
+        arr_.resize(n);
+        help::parallel_for(n, [&](std::size_t b, std::size_t e) {
+            for (std::size_t s = b; s < e; ++s) arr_[s] = sorted[inorderRank(s, n)];
+        });
+    }
+
+    // In place only with the plain allocator: the sorted keys' buffer
+    // becomes arr_. Other allocators gather into their own storage.
+    void build(std::vector<Key>& keys, KeyMode mode, Freeze freeze = Freeze::Gather)
+    {
+        const bool inPlace = freeze == Freeze::InPlace && std::is_same_v<Array, std::vector<Key>>;
+        auto t0 = std::chrono::steady_clock::now();
+        if      (mode == KeyMode::Multiset) dedupSortCounted(keys, inPlace);
+        else if (mode == KeyMode::Set)      dedupSort(keys, inPlace);
+        auto t1 = std::chrono::steady_clock::now();
+        if constexpr (std::is_same_v<Array, std::vector<Key>>) {
+            if (inPlace) {
+                help::eytzingerInPlace(keys.data(), keys.size());
+                arr_ = std::move(keys);
+            } else {
+                buildEyt(keys);
+            }
+        } else {
+            buildEyt(keys);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        this->stats_.sort_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        this->stats_.layout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        levels_ = std::bit_width(arr_.size() + 1) - 1;
+    }
+
+    // Branchless lower_bound on the 1-based view of keys(): the complete levels
+    // are walked unconditionally, the partial last level takes one guarded
+    // step, and the answer is the last node where the descent went left,
+    // i.e. the index with its trailing one-bits (right turns) shifted out.
+    // The 16 descendants four levels further down are prefetched: every
+    // line they span, as the 0-based array puts them across two for most i.
+    // Returns the 0-based slot of the first key >= k (> k for Upper), or
+    // keys().size().
+    template<bool Upper = false>
+    std::size_t boundIdx(const Key& k) const
+    {
+        const auto a = keys();
+        const std::size_t n = a.size();
+        if (n == 0) return 0;
+
+        auto right = [&](const Key& x) { return Upper ? !Tr::less(k, x) : Tr::less(x, k); };
+
+        std::size_t i = 1;
+        for (unsigned h = levels_; h; --h) {
+            help::prefetchSpan<16>(a.data() + 16*i - 1);
+            i = 2*i + right(a[i - 1]);
+        }
+
+        std::size_t next = 2*i + right(a[std::min(i, n) - 1]);
+        i = (i <= n) ? next : i;
+
+        i >>= __builtin_ffsll(static_cast<long long>(~i));
+        return i ? i - 1 : n;
     }
 
-    void buildEyt(std::size_t idx, std::size_t& pos,
-                  const std::vector<Key>& sorted)
+    std::size_t lowerBoundIdx(const Key& k) const { return boundIdx<false>(k); }
+
+    // Keys (copies in multiset mode) in front of slot s; s == n is the end.
+    std::uint64_t before(std::size_t s) const
     {
-        if (idx >= sorted.size()) return;
-        buildEyt(2*idx + 1, pos, sorted);
-        arr_[idx] = sorted[pos++];
-        buildEyt(2*idx + 2, pos, sorted);
+        const std::size_t n = keys().size();
+        const std::size_t r = (s >= n) ? n : inorderRank(s, n);
+        return below_.empty() ? r : below_[r];
     }
 
-    void freeze()
+    // In-order successor of slot s: the leftmost node of the right subtree,
+    // or else the first ancestor reached from a left child.
+    static std::size_t nextIdx(std::size_t s, std::size_t n)
     {
-        if (frozen_) return;
-        dedupSort(inserts_);
-        arr_.resize(inserts_.size());
-        std::size_t p = 0;
-        buildEyt(0, p, inserts_);
-        frozen_ = true;
-        inserts_.clear();
-        inserts_.shrink_to_fit();
+        std::size_t j = s + 1;
+        if (2*j + 1 <= n) {
+            j = 2*j + 1;
+            while (2*j <= n) j = 2*j;
+        } else {
+            j >>= __builtin_ffsll(static_cast<long long>(~j));
+        }
+        return j ? j - 1 : n;
     }
 
-private:
-    std::vector<Key> inserts_;           
-    bool             frozen_ = false;
+    // lowerBoundIdx for group_ keys at a time: every descent has the same
+    // fixed depth, so the lanes advance one level per round and each lane
+    // prefetches the node it reads in the next round while the others work.
+    template<class Emit>
+    void lowerBoundIdxBatch(std::span<const Key> keys, Emit emit) const
+    {
+        const auto a = this->keys();
+        const std::size_t n = a.size();
+        const std::size_t G = this->group_;
+        std::size_t idx[IBST<Key>::kMaxGroup];
+
+        for (std::size_t base = 0; base < keys.size(); base += G) {
+            const std::size_t m = std::min(G, keys.size() - base);
+            const Key* kb = keys.data() + base;
+            if (n == 0) {
+                for (std::size_t g = 0; g < m; ++g) emit(base + g, n);
+                continue;
+            }
+
+            for (std::size_t g = 0; g < m; ++g) idx[g] = 1;
+            for (unsigned h = levels_; h; --h) {
+                for (std::size_t g = 0; g < m; ++g) {
+                    std::size_t i = 2*idx[g] + Tr::less(a[idx[g] - 1], kb[g]);
+                    __builtin_prefetch(a.data() + i - 1, 0, 1);
+                    idx[g] = i;
+                }
+            }
+            for (std::size_t g = 0; g < m; ++g) {
+                std::size_t i    = idx[g];
+                std::size_t next = 2*i + Tr::less(a[std::min(i, n) - 1], kb[g]);
+                i = (i <= n) ? next : i;
+                i >>= __builtin_ffsll(static_cast<long long>(~i));
+                emit(base + g, i ? i - 1 : n);
+            }
+        }
+    }
 
 public:
-    void insert(const Key& k) override {
-        if (frozen_)
-            throw std::logic_error("BST_EYT: insert after first query");
-        inserts_.push_back(k);
+    BSTEyt() = default;
+    explicit BSTEyt(std::vector<Key> keys, KeyMode mode = KeyMode::Set, Freeze freeze = Freeze::Gather) {
+        build(keys, mode, freeze);
     }
 
-    bool contains(const Key& k) const override {
-        const_cast<BSTEyt*>(this)->freeze();
+    // Queries an index file written by save() in place; the mapping stays
+    // alive as long as any copy of the tree does.
+    explicit BSTEyt(std::shared_ptr<const index_file::Mapping> map, bool verify = false)
+        : map_(std::move(map)),
+          mapped_(map_->template keys<Key>(index_file::Layout::Eytzinger, verify))
+    {
+        levels_ = std::bit_width(mapped_.size() + 1) - 1;
+    }
 
+    bool contains(const Key& k) const override {
+        const auto a = keys();
         std::size_t i = 0;
-        while (i < arr_.size()) {
-            if (k == arr_[i])           return true;
-            i = (k < arr_[i]) ? 2*i + 1 : 2*i + 2;
+        while (i < a.size()) {
+            if (Tr::equal(k, a[i]))  return true;
+            i = Tr::less(k, a[i]) ? 2*i + 1 : 2*i + 2;
         }
         return false;
     }
 
+    std::optional<Key> lower_bound(const Key& k) const override {
+        const auto a = keys();
+        std::size_t i = lowerBoundIdx(k);
+        if (i == a.size()) return std::nullopt;
+        return a[i];
+    }
+
+    void contains_batch(std::span<const Key> keys,
+                        std::span<bool>      out) const override
+    {
+        const auto a = this->keys();
+        lowerBoundIdxBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = i < a.size() && Tr::equal(a[i], keys[j]);
+        });
+    }
+
+    void lower_bound_batch(std::span<const Key>          keys,
+                           std::span<std::optional<Key>> out) const override
+    {
+        const auto a = this->keys();
+        lowerBoundIdxBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = (i < a.size()) ? std::optional<Key>(a[i]) : std::nullopt;
+        });
+    }
+
     std::size_t size_bytes() const override {
-        return arr_.size() * sizeof(Key);
+        return keys().size() * sizeof(Key) + below_.size() * sizeof(std::uint64_t);
+    }
+
+    // Smallest key > k.
+    std::optional<Key> upper_bound(const Key& k) const {
+        const auto a = keys();
+        std::size_t i = boundIdx<true>(k);
+        if (i == a.size()) return std::nullopt;
+        return a[i];
+    }
+
+    // Number of keys < k; copies are counted in multiset mode.
+    std::uint64_t rank(const Key& k) const { return before(lowerBoundIdx(k)); }
+
+    // Number of keys in [lo, hi).
+    std::uint64_t count_range(const Key& lo, const Key& hi) const {
+        if (!Tr::less(lo, hi)) return 0;
+        return rank(hi) - rank(lo);
+    }
+
+    // Copies of k: 0 or 1 in set mode.
+    std::uint64_t count(const Key& k) const {
+        return before(boundIdx<true>(k)) - rank(k);
+    }
+
+    bool multiset() const { return !below_.empty(); }
+
+    // In-order iterator over the distinct keys. Every step is amortised
+    // O(1) and the bottom levels it spends most steps in are contiguous.
+    class const_iterator {
+        const BSTEyt* t_ = nullptr;
+        std::size_t   s_ = 0;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = Key;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const Key*;
+        using reference         = const Key&;
+
+        const_iterator() = default;
+        const_iterator(const BSTEyt* t, std::size_t s) : t_(t), s_(s) {}
+
+        reference operator*()  const { return t_->keys()[s_]; }
+        std::size_t slot()     const { return s_; }
+        pointer   operator->() const { return &**this; }
+        const_iterator& operator++() { s_ = nextIdx(s_, t_->keys().size()); return *this; }
+        const_iterator  operator++(int) { auto c = *this; ++*this; return c; }
+        bool operator==(const const_iterator& o) const { return s_ == o.s_; }
+
+        // copies of the current key (1 in set mode)
+        std::uint64_t multiplicity() const {
+            return t_->before(nextIdx(s_, t_->keys().size())) - t_->before(s_);
+        }
+    };
+
+    const_iterator begin() const {
+        const std::size_t n = keys().size();
+        std::size_t j = 1;
+        while (2*j <= n) j = 2*j;
+        return {this, n ? j - 1 : 0};
+    }
+    const_iterator end() const { return {this, keys().size()}; }
+
+    // Iterator pair over the keys in [lo, hi).
+    struct Range {
+        const_iterator first, last;
+        const_iterator begin() const { return first; }
+        const_iterator end()   const { return last; }
+    };
+    Range range(const Key& lo, const Key& hi) const {
+        if (!Tr::less(lo, hi)) return {end(), end()};
+        return {seek(lo), seek(hi)};
+    }
+
+    // Iterator at the first key >= k.
+    const_iterator seek(const Key& k) const { return {this, lowerBoundIdx(k)}; }
+
+    // Writes the layout to path (see IndexFile.h). Multiset counts are not
+    // part of the format; an opened tree is always a set.
+    void save(const std::string& path) const {
+        index_file::write<Key>(path, index_file::Layout::Eytzinger, keys());
+    }
+
+    // Maps an index file written by save(); queries read the page cache
+    // directly.
+    template<class Tree = BSTEyt>
+    static Tree open(const std::string& path, bool verify = false) {
+        return Tree(std::make_shared<const index_file::Mapping>(path), verify);
     }
 };
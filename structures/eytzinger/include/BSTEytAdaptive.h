@@ -0,0 +1,172 @@
+#pragma once
+#include "BSTEyt.h"
+#include "CacheInfo.h"
+#include "Prefetch.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+// Branchless Eytzinger search whose prefetch lookahead is chosen for the
+// tree at hand instead of fixed per class. Prefetching D levels ahead
+// pulls in the 2^D descendants of the current node, which are contiguous
+// but, in the 0-based array, rarely line aligned: every line they span is
+// prefetched. Deep lookahead only pays once the tree outgrows the caches.
+// With L the levels of one line's worth of keys (4 for int), the plan
+// from the cache sizes (see CacheInfo.h) is:
+//
+//   fits in half of L1   no prefetch
+//   fits in half of L2   D = L - 1, an L2 hit needs little lookahead
+//   fits in half of L3   D = L
+//   larger               D = L + 1, to cover DRAM latency
+//
+// and the top levels that fit in half of L1 are walked without prefetch
+// in any case; they stay hot. calibrate() instead times the candidate
+// depths on a sample of the keys and keeps the fastest. prefetch_plan()
+// tells what was chosen.
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTEytAdaptive : public BSTEyt<Key, Alloc> {
+    using Base = BSTEyt<Key, Alloc>;
+    using Tr   = KeyTraits<Key>;
+
+public:
+    struct PrefetchPlan {
+        unsigned         depth = 0;     // levels of lookahead, 0 = no prefetch
+        unsigned         skip  = 0;     // top levels descended without prefetch
+        bool             calibrated = false;
+        help::CacheSizes caches;
+    };
+
+    static constexpr unsigned kMaxDepth = 6;
+
+private:
+    PrefetchPlan plan_;
+
+    // Levels of a tree with this many bytes in the top of it.
+    static unsigned levelsIn(std::size_t bytes) {
+        return std::bit_width(bytes / sizeof(Key) + 1) - 1;
+    }
+
+    // Levels one cache line of descendants spans.
+    static unsigned lineDepth(const help::CacheSizes& c) {
+        return std::bit_width(std::max<std::size_t>(c.line / sizeof(Key), 1)) - 1;
+    }
+
+    void plan()
+    {
+        plan_.caches = help::cacheSizes();
+        const auto&       c     = plan_.caches;
+        const std::size_t bytes = Base::keys().size() * sizeof(Key);
+        const unsigned    line  = lineDepth(c);
+
+        if      (bytes <= c.l1 / 2) plan_.depth = 0;
+        else if (bytes <= c.l2 / 2) plan_.depth = line - (line > 0);
+        else if (bytes <= c.l3 / 2) plan_.depth = line;
+        else                        plan_.depth = line + 1;
+        plan_.depth      = std::min(plan_.depth, kMaxDepth);
+        plan_.skip       = std::min(levelsIn(c.l1 / 2), this->levels_);
+        plan_.calibrated = false;
+    }
+
+    // lowerBoundIdx with a fixed lookahead; the first skip levels only
+    // compare, the rest also touch every line of the descendants D levels down.
+    template<unsigned D>
+    std::size_t descend(const Key& k) const
+    {
+        const auto a = Base::keys();
+        const std::size_t n = a.size();
+        if (n == 0) return 0;
+
+        std::size_t i = 1;
+        unsigned    h = this->levels_;
+        for (; h > this->levels_ - plan_.skip; --h) i = 2*i + Tr::less(a[i - 1], k);
+        for (; h; --h) {
+            if constexpr (D > 0) help::prefetchSpan<std::size_t(1) << D>(a.data() + (i << D) - 1);
+            i = 2*i + Tr::less(a[i - 1], k);
+        }
+
+        std::size_t next = 2*i + Tr::less(a[std::min(i, n) - 1], k);
+        i = (i <= n) ? next : i;
+        i >>= __builtin_ffsll(static_cast<long long>(~i));
+        return i ? i - 1 : n;
+    }
+
+    std::size_t lowerBoundPos(const Key& k) const
+    {
+        switch (plan_.depth) {
+        case 0:  return descend<0>(k);
+        case 1:  return descend<1>(k);
+        case 2:  return descend<2>(k);
+        case 3:  return descend<3>(k);
+        case 4:  return descend<4>(k);
+        case 5:  return descend<5>(k);
+        default: return descend<6>(k);
+        }
+    }
+
+public:
+    BSTEytAdaptive() { plan(); }
+
+    explicit BSTEytAdaptive(std::vector<Key> keys, KeyMode mode = KeyMode::Set, bool calibrate = false,
+                            Freeze freeze = Freeze::Gather)
+        : Base(std::move(keys), mode, freeze)
+    {
+        plan();
+        if (calibrate) this->calibrate();
+    }
+
+    explicit BSTEytAdaptive(std::shared_ptr<const index_file::Mapping> map, bool verify = false)
+        : Base(std::move(map), verify)
+    {
+        plan();
+    }
+
+    bool contains(const Key& k) const override {
+        const auto  a = Base::keys();
+        std::size_t i = lowerBoundPos(k);
+        return i < a.size() && Tr::equal(a[i], k);
+    }
+
+    std::optional<Key> lower_bound(const Key& k) const override {
+        const auto  a = Base::keys();
+        std::size_t i = lowerBoundPos(k);
+        if (i == a.size()) return std::nullopt;
+        return a[i];
+    }
+
+    // Times lookups of sampled keys for lookahead 0 and around the line
+    // depth, best of three rounds each, and keeps the fastest depth.
+    void calibrate(std::size_t samples = 1 << 14)
+    {
+        const auto a = Base::keys();
+        if (a.empty()) return;
+
+        std::mt19937_64 rng(a.size());
+        std::vector<Key> probe(samples);
+        for (Key& k : probe) k = a[rng() % a.size()];
+
+        const unsigned line = lineDepth(plan_.caches);
+        unsigned best = plan_.depth;
+        double   best_ns = -1;
+        for (unsigned d : {0u, line - (line > 0), line, line + 1, line + 2}) {
+            plan_.depth = std::min(d, kMaxDepth);
+            double ns = -1;
+            for (int round = 0; round < 3; ++round) {
+                std::size_t acc = 0;
+                auto t0 = std::chrono::steady_clock::now();
+                for (const Key& k : probe) acc += lowerBoundPos(k);
+                auto t1 = std::chrono::steady_clock::now();
+                asm volatile("" : : "g"(acc) : "memory");
+                double r = std::chrono::duration<double, std::nano>(t1 - t0).count();
+                if (ns < 0 || r < ns) ns = r;
+            }
+            if (best_ns < 0 || ns < best_ns) { best_ns = ns; best = plan_.depth; }
+        }
+        plan_.depth      = best;
+        plan_.calibrated = true;
+    }
+
+    const PrefetchPlan& prefetch_plan() const { return plan_; }
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include "IBST.h"
+#include "KeyTraits.h"
+#include "AlignedAllocator.h"
+#include "RadixSort.h"
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <span>
+
+// Eytzinger layout stored 1-based in a 64-byte aligned array: slot 0 is
+// padding and node i lives at t_[i]. The descendants of node i D levels
+// down are nodes i*2^D .. i*2^D + 2^D - 1, so with 2^D keys to a cache line
+// (D = 4 for int) they start on a line boundary and fill exactly that
+// line. The descent then needs a single prefetch every level, of the line
+// D levels ahead, where the 0-based BSTEyt may straddle two lines and
+// BSTEytPrefFour issues one prefetch per descendant.
+template<class Key, class Alloc = AlignedAllocator<Key>>
+class BSTEytAligned : public IBST<Key> {
+    using Tr = KeyTraits<Key>;
+
+    static_assert(64 % sizeof(Key) == 0, "keys must tile a cache line");
+
+public:
+    static constexpr unsigned kLineDepth = std::bit_width(64 / sizeof(Key)) - 1;
+
+private:
+    std::vector<Key, Alloc> t_;         // t_[1..n], t_[0] unused
+    std::size_t             n_      = 0;
+    unsigned                levels_ = 0;   // complete levels: bit_width(n+1) - 1
+
+    // In-order walk of the 1-based tree: leftmost node, then successors.
+    void layout(const std::vector<Key>& sorted)
+    {
+        t_.assign(n_ + 1, Key{});
+        if (n_ == 0) return;
+        std::size_t j = 1;
+        while (2*j <= n_) j = 2*j;
+        for (const Key& k : sorted) {
+            t_[j] = k;
+            if (2*j + 1 <= n_) {
+                j = 2*j + 1;
+                while (2*j <= n_) j = 2*j;
+            } else {
+                j >>= __builtin_ffsll(static_cast<long long>(~j));
+            }
+        }
+    }
+
+    // 1-based node of the first key >= k, 0 if none. Same descent as
+    // BSTEyt::boundIdx, the prefetch being one aligned line.
+    std::size_t lowerBoundNode(const Key& k) const
+    {
+        if (n_ == 0) return 0;
+        const Key* t = t_.data();
+
+        std::size_t i = 1;
+        for (unsigned h = levels_; h; --h) {
+            __builtin_prefetch(t + (i << kLineDepth), 0, 1);
+            i = 2*i + Tr::less(t[i], k);
+        }
+
+        std::size_t next = 2*i + Tr::less(t[std::min(i, n_)], k);
+        i = (i <= n_) ? next : i;
+        return i >> __builtin_ffsll(static_cast<long long>(~i));
+    }
+
+    // lowerBoundNode for group_ keys at a time, the lanes in lockstep.
+    template<class Emit>
+    void lowerBoundNodeBatch(std::span<const Key> keys, Emit emit) const
+    {
+        const Key* t = t_.data();
+        const std::size_t G = this->group_;
+        std::size_t idx[IBST<Key>::kMaxGroup];
+
+        for (std::size_t base = 0; base < keys.size(); base += G) {
+            const std::size_t m = std::min(G, keys.size() - base);
+            const Key* kb = keys.data() + base;
+            if (n_ == 0) {
+                for (std::size_t g = 0; g < m; ++g) emit(base + g, 0);
+                continue;
+            }
+
+            for (std::size_t g = 0; g < m; ++g) idx[g] = 1;
+            for (unsigned h = levels_; h; --h) {
+                for (std::size_t g = 0; g < m; ++g) {
+                    std::size_t i = 2*idx[g] + Tr::less(t[idx[g]], kb[g]);
+                    __builtin_prefetch(t + i, 0, 1);
+                    idx[g] = i;
+                }
+            }
+            for (std::size_t g = 0; g < m; ++g) {
+                std::size_t i    = idx[g];
+                std::size_t next = 2*i + Tr::less(t[std::min(i, n_)], kb[g]);
+                i = (i <= n_) ? next : i;
+                emit(base + g, i >> __builtin_ffsll(static_cast<long long>(~i)));
+            }
+        }
+    }
+
+public:
+    BSTEytAligned() : t_(1) {}
+
+    explicit BSTEytAligned(std::vector<Key> keys)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        help::sortUnique(keys, KeyLess<Key>{}, KeyEqual<Key>{});
+        auto t1 = std::chrono::steady_clock::now();
+        n_      = keys.size();
+        levels_ = std::bit_width(n_ + 1) - 1;
+        layout(keys);
+        auto t2 = std::chrono::steady_clock::now();
+        this->stats_.sort_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        this->stats_.layout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    }
+
+    bool contains(const Key& k) const override {
+        std::size_t i = lowerBoundNode(k);
+        return i && Tr::equal(t_[i], k);
+    }
+
+    std::optional<Key> lower_bound(const Key& k) const override {
+        std::size_t i = lowerBoundNode(k);
+        if (!i) return std::nullopt;
+        return t_[i];
+    }
+
+    void contains_batch(std::span<const Key> keys,
+                        std::span<bool>      out) const override
+    {
+        lowerBoundNodeBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = i && Tr::equal(t_[i], keys[j]);
+        });
+    }
+
+    void lower_bound_batch(std::span<const Key>          keys,
+                           std::span<std::optional<Key>> out) const override
+    {
+        lowerBoundNodeBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = i ? std::optional<Key>(t_[i]) : std::nullopt;
+        });
+    }
+
+    // Includes the padding slot.
+    std::size_t size_bytes() const override { return t_.size() * sizeof(Key); }
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include "BSTEyt.h"
+#include <cstddef>
+
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTEytBranchless : public BSTEyt<Key, Alloc> {
+    using Base = BSTEyt<Key, Alloc>;
+    using Tr   = KeyTraits<Key>;
+
+public:
+    using Base::Base;
+
+    bool contains(const Key& k) const override {
+        std::size_t i = lower_bound_pos(k);
+        const auto  a = Base::keys();
+        return i < a.size() && Tr::equal(a[i], k);
+    }
+
+    // Eytzinger slot of the smallest key >= k, size of the layout if none.
+    std::size_t lower_bound_pos(const Key& k) const {
+        return Base::lowerBoundIdx(k);
+    }
+
+    // lower_bound_pos for every key, group_ descents at a time.
+    void lower_bound_pos_batch(std::span<const Key> keys, std::span<std::size_t> out) const {
+        Base::lowerBoundIdxBatch(keys, [&](std::size_t j, std::size_t i) { out[j] = i; });
+    }
+};
@@ -0,0 +1,253 @@
+#pragma once
+#include "IBST.h"
+#include "AlignedAllocator.h"
+#include "Parallel.h"
+#include "RadixSort.h"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <chrono>
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+// Eytzinger tree cut into cache-line blocks with frame-of-reference
+// compressed keys. The sorted keys are laid out as a perfect tree of depth
+// D = bit_width(n), the slots past the n keys holding copies of the
+// largest one, which is split top-down into stripes of levels; every block
+// of a stripe is one 64-byte line holding a complete subtree in local
+// (1-based) Eytzinger order:
+//
+//   narrow  depth 5: the subtree's minimum (its leftmost leaf, node 16)
+//           as a 32-bit base and the other 30 nodes as 16-bit deltas,
+//   wide    depth 4: 15 plain 32-bit keys.
+//
+// Stripes are chosen bottom-up, narrow wherever every block of the stripe
+// spans less than 2^16, so dense key sets resolve five levels per line
+// instead of the single level of BSTEyt below the first few. One SIMD
+// compare of k against the whole line gives a bit per node, the in-block
+// descent only shifts that mask, and the child block follows from the
+// exit leaf.
+//
+// The padding slots are a suffix in key order, so only the blocks of a
+// stripe that hold a real key are stored (all but at most one full); a
+// descent that would enter a block of padding alone stops, the answer
+// being the last left turn so far or else the largest key. Dense keys thus
+// take ~2.1 bytes per key for any n, and sparse ones (wide stripes, 15
+// keys per line) ~4.3, against 4 for BSTEyt. Deltas are 16 bits only: a
+// line of 8-bit deltas would need 63 nodes for one more level, which do
+// not fit beside the base, so it would hold the same five levels. Only
+// 32-bit integer keys are supported.
+template<class Key, class Alloc = AlignedAllocator<Key>>
+class BSTEytCompressed : public IBST<Key> {
+    static_assert(std::is_integral_v<Key> && sizeof(Key) == 4,
+                  "frame-of-reference blocks hold 32-bit integer keys");
+
+    struct alignas(64) Block { std::uint8_t bytes[64]; };
+
+    struct Stripe {
+        std::size_t offset;     // first block of the stripe
+        std::size_t blocks;     // those holding a real key; the rest are not stored
+        unsigned    depth;      // levels per block
+        bool        narrow;
+    };
+
+    static constexpr unsigned      kNarrowDepth = 5;
+    static constexpr unsigned      kWideDepth   = 4;
+    static constexpr std::int64_t  kMaxDelta    = 65534;   // < the clamped search delta
+
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+
+    std::vector<Block, BlockAlloc> blocks_;
+    std::vector<Stripe>            stripes_;
+    Key                            max_{};     // the largest key
+
+    // Lane of local node j (1..31, j != 16) in a narrow block; lanes 0-1
+    // hold the base.
+    static constexpr unsigned lane(unsigned j) { return j < 16 ? j + 1 : j; }
+
+    // Sorted position of the node with index i on level l of a perfect
+    // tree of depth D.
+    static std::size_t pos(unsigned D, unsigned l, std::size_t i) {
+        return ((2*i + 1) << (D - 1 - l)) - 1;
+    }
+
+    // Bit j set iff node j of the narrow block is < k.
+    static std::uint32_t narrowMask(const Block& b, Key k, Key& base)
+    {
+        std::memcpy(&base, b.bytes, sizeof(Key));
+        const std::int64_t d = std::clamp<std::int64_t>(std::int64_t(k) - base, 0, kMaxDelta + 1);
+        std::uint32_t lanes;    // bit = lane < d
+#if defined(__AVX512BW__)
+        __m512i v = _mm512_load_si512(b.bytes);
+        lanes = _mm512_cmplt_epu16_mask(v, _mm512_set1_epi16(static_cast<short>(d)));
+#elif defined(__AVX2__) && defined(__BMI2__)
+        const __m256i dv = _mm256_set1_epi16(static_cast<short>(d));
+        auto half = [&](const void* p) {
+            __m256i v  = _mm256_load_si256(static_cast<const __m256i*>(p));
+            __m256i ge = _mm256_cmpeq_epi16(_mm256_max_epu16(v, dv), v);
+            return _pext_u32(~static_cast<std::uint32_t>(_mm256_movemask_epi8(ge)), 0x55555555u);
+        };
+        lanes = half(b.bytes) | half(b.bytes + 32) << 16;
+#else
+        lanes = 0;
+        for (unsigned l = 2; l < 32; ++l) {
+            std::uint16_t x;
+            std::memcpy(&x, b.bytes + 2*l, 2);
+            lanes |= std::uint32_t(x < d) << l;
+        }
+#endif
+        return ((lanes >> 1) & 0xFFFEu) | (lanes & 0xFFFE0000u) | (std::uint32_t(d > 0) << 16);
+    }
+
+    // Bit j set iff node j of the wide block is < k.
+    static std::uint32_t wideMask(const Block& b, Key k)
+    {
+#if defined(__AVX512F__)
+        __m512i v = _mm512_load_si512(b.bytes);
+        return _mm512_cmplt_epi32_mask(v, _mm512_set1_epi32(k));
+#elif defined(__AVX2__)
+        __m256i kv = _mm256_set1_epi32(k);
+        __m256i lo = _mm256_cmpgt_epi32(kv, _mm256_load_si256((const __m256i*)b.bytes));
+        __m256i hi = _mm256_cmpgt_epi32(kv, _mm256_load_si256((const __m256i*)(b.bytes + 32)));
+        return _mm256_movemask_ps(_mm256_castsi256_ps(lo))
+             | _mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+#else
+        std::uint32_t m = 0;
+        for (unsigned j = 1; j < 16; ++j) {
+            Key x;
+            std::memcpy(&x, b.bytes + 4*j, 4);
+            m |= std::uint32_t(x < k) << j;
+        }
+        return m;
+#endif
+    }
+
+    static Key narrowKey(const Block& b, Key base, unsigned j)
+    {
+        if (j == 16) return base;
+        std::uint16_t x;
+        std::memcpy(&x, b.bytes + 2*lane(j), 2);
+        return static_cast<Key>(base + x);
+    }
+
+    static Key wideKey(const Block& b, unsigned j)
+    {
+        Key x;
+        std::memcpy(&x, b.bytes + 4*j, 4);
+        return x;
+    }
+
+    void build(std::vector<Key>& keys)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        help::sortUnique(keys);
+        const std::size_t n = keys.size();
+        auto t1 = std::chrono::steady_clock::now();
+
+        const unsigned D = std::bit_width(n);        // 2^D - 1 >= n
+        auto at = [&](unsigned l, std::size_t i) { return keys[std::min(pos(D, l, i), n - 1)]; };
+        // Blocks of a stripe starting at level L with a real key: the
+        // subtree of block b starts at sorted position b << (D - L).
+        auto stored = [&](unsigned L) { return n ? ((n - 1) >> (D - L)) + 1 : 0; };
+        max_ = n ? keys[n - 1] : Key{};
+
+        // Stripes from the bottom up. A block spans its leftmost to its
+        // rightmost leaf; narrow blocks are always full depth, so a short
+        // top stripe is wide.
+        std::vector<Stripe> rev;
+        for (unsigned rem = D; rem; ) {
+            const unsigned d = kNarrowDepth, L = rem - std::min(d, rem);
+            bool narrow = rem >= d;
+            for (std::size_t b = 0; narrow && b < stored(L); ++b) {
+                std::size_t first = b << (d - 1), last = first + (std::size_t(1) << (d - 1)) - 1;
+                narrow = std::int64_t(at(L + d - 1, last)) - at(L + d - 1, first) <= kMaxDelta;
+            }
+            rev.push_back({0, 0, narrow ? d : std::min(kWideDepth, rem), narrow});
+            rem -= rev.back().depth;
+        }
+        stripes_.assign(rev.rbegin(), rev.rend());
+
+        std::size_t total = 0;
+        unsigned    L = 0;
+        for (auto& s : stripes_) {
+            s.offset = total;
+            s.blocks = stored(L);
+            total   += s.blocks;
+            L       += s.depth;
+        }
+        blocks_.assign(total, Block{});
+
+        L = 0;
+        for (const auto& s : stripes_) {
+            help::parallel_for(s.blocks, [&](std::size_t lo, std::size_t hi) {
+                for (std::size_t b = lo; b < hi; ++b) {
+                    Block& blk = blocks_[s.offset + b];
+                    for (unsigned j = 1; j < (1u << s.depth); ++j) {
+                        unsigned    dl = std::bit_width(j) - 1;
+                        Key         x  = at(L + dl, (b << dl) + (j - (1u << dl)));
+                        if (!s.narrow) { std::memcpy(blk.bytes + 4*j, &x, 4); continue; }
+                        const Key base = at(L + 4, b << 4);       // node 16
+                        if (j == 16) { std::memcpy(blk.bytes, &base, 4); continue; }
+                        std::uint16_t delta = static_cast<std::uint16_t>(std::int64_t(x) - base);
+                        std::memcpy(blk.bytes + 2*lane(j), &delta, 2);
+                    }
+                }
+            }, 1 << 10);
+            L += s.depth;
+        }
+
+        auto t2 = std::chrono::steady_clock::now();
+        this->stats_.sort_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        this->stats_.layout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    }
+
+public:
+    BSTEytCompressed() = default;
+    explicit BSTEytCompressed(std::vector<Key> keys) { build(keys); }
+
+    // The answer is the last node on the path that is >= k, tracked as
+    // the last left turn of every block. Below the stored blocks all keys
+    // are the largest, which only answers if no left turn came before.
+    std::optional<Key> lower_bound(const Key& k) const override
+    {
+        Key         hit{};
+        bool        any = false;
+        std::size_t b   = 0;
+        for (const auto& s : stripes_) {
+            if (b >= s.blocks) {
+                if (any) return hit;
+                return k <= max_ ? std::optional<Key>(max_) : std::nullopt;
+            }
+            const Block& blk = blocks_[s.offset + b];
+            Key base{};
+            const std::uint32_t m = s.narrow ? narrowMask(blk, k, base) : wideMask(blk, k);
+
+            unsigned j = 1, left = 0;
+            for (unsigned h = 0; h < s.depth; ++h) {
+                unsigned r = (m >> j) & 1;
+                left = r ? left : j;
+                j    = 2*j + r;
+            }
+            const Key cand = s.narrow ? narrowKey(blk, base, left) : wideKey(blk, left);
+            hit  = left ? cand : hit;
+            any |= left != 0;
+            b = (b << s.depth) + (j - (1u << s.depth));
+        }
+        return any ? std::optional<Key>(hit) : std::nullopt;
+    }
+
+    bool contains(const Key& k) const override {
+        auto lb = lower_bound(k);
+        return lb && *lb == k;
+    }
+
+    std::size_t size_bytes() const override {
+        return blocks_.size() * sizeof(Block) + stripes_.size() * sizeof(Stripe);
+    }
+};
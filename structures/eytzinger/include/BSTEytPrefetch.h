@@ -3,15 +3,16 @@
 #include <cstddef>
 
 
-template<class Key>
-class BSTEytPref : public BSTEyt<Key> {
-    using Base = BSTEyt<Key>;
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTEytPref : public BSTEyt<Key, Alloc> {
+    using Base = BSTEyt<Key, Alloc>;
+    using Tr   = KeyTraits<Key>;
 
 public:
-    bool contains(const Key& k) const override {
-        const_cast<BSTEytPref*>(this)->Base::freeze();
+    using Base::Base;
 
-        const auto& a = Base::arr_;   
+    bool contains(const Key& k) const override {
+        const auto a = Base::keys();   
         std::size_t i = 0;
 
         while (i < a.size()) {
@@ -20,8 +21,8 @@ public:
             if (l < a.size()) __builtin_prefetch(&a[l], 0, 1);
             if (r < a.size()) __builtin_prefetch(&a[r], 0, 1);
 
-            if      (k == a[i]) return true;
-            else if (k <  a[i]) i = l;
+            if      (Tr::equal(k, a[i])) return true;
+            else if (Tr::less(k, a[i])) i = l;
             else                i = r;
         }
         return false;
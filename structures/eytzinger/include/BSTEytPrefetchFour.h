@@ -2,20 +2,22 @@
 #include "BSTEyt.h"
 #include <cstddef>
 
-template<class Key>
-class BSTEytPrefFour : public BSTEyt<Key> {
-    using Base = BSTEyt<Key>;
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTEytPrefFour : public BSTEyt<Key, Alloc> {
+    using Base = BSTEyt<Key, Alloc>;
+    using Tr   = KeyTraits<Key>;
 
-    static inline void pf(const std::vector<Key>& a, std::size_t idx)
+    static inline void pf(std::span<const Key> a, std::size_t idx)
     {
         if (idx < a.size()) __builtin_prefetch(&a[idx], 0, 1);
     }
 
 public:
+    using Base::Base;
+
     bool contains(const Key& k) const override
     {
-        const_cast<BSTEytPrefFour*>(this)->Base::freeze();
-        const auto& a = Base::arr_;
+        const auto a = Base::keys();
 
         std::size_t i = 0;
         while (i < a.size()) {
@@ -36,8 +38,8 @@ public:
                 }
             }
 
-            if      (k == a[i]) return true;
-            else if (k <  a[i]) i = 2*i + 1;
+            if      (Tr::equal(k, a[i])) return true;
+            else if (Tr::less(k, a[i])) i = 2*i + 1;
             else                i = 2*i + 2;
         }
         return false;
@@ -6,18 +6,19 @@
 #include <cmath>
 
 
-template<class Key, std::size_t Budget = 8>
-class BSTEytPrefProb : public BSTEyt<Key> {
-    using Base = BSTEyt<Key>;
+template<class Key, std::size_t Budget = 8, class Alloc = std::allocator<Key>>
+class BSTEytPrefProb : public BSTEyt<Key, Alloc> {
+    using Base = BSTEyt<Key, Alloc>;
+    using Tr   = KeyTraits<Key>;
     static_assert(Budget >= 2, "Budget must be at least two");
 
 
-    static inline void pf(const std::vector<Key>& a, std::size_t idx)
+    static inline void pf(std::span<const Key> a, std::size_t idx)
     {
         if (idx < a.size()) __builtin_prefetch(&a[idx], 0, 1);
     }
 
-    static void prefetchSubtree(const std::vector<Key>& a,
+    static void prefetchSubtree(std::span<const Key> a,
                                 std::size_t            start,
                                 std::size_t&           quota)
     {
@@ -43,35 +44,36 @@ class BSTEytPrefProb : public BSTEyt<Key> {
         }
     }
 
-    mutable bool minmax_ready_ = false;
-    mutable Key  min_key_{};
-    mutable Key  max_key_{};
+    Key min_key_{};
+    Key max_key_{};
 
-    [[gnu::always_inline]] inline void ensureMinMax() const
+    // The extremes sit at the ends of the leftmost and rightmost paths.
+    void initMinMax()
     {
-        if (__builtin_expect(minmax_ready_, 1)) [[likely]]
-            return;
-
-        const auto& a = Base::arr_;
-        if (__builtin_expect(a.empty(), 0)) [[unlikely]] return;                      
-        auto [mn, mx] = std::minmax_element(a.begin(), a.end());
-        min_key_ = *mn;
-        max_key_ = *mx;
-        minmax_ready_ = true;
+        const auto a = Base::keys();
+        if (a.empty()) return;
+        std::size_t i = 0;
+        while (2*i + 1 < a.size()) i = 2*i + 1;
+        min_key_ = a[i];
+        i = 0;
+        while (2*i + 2 < a.size()) i = 2*i + 2;
+        max_key_ = a[i];
     }
 
 public:
+    BSTEytPrefProb() = default;
+    explicit BSTEytPrefProb(std::vector<Key> keys, KeyMode mode = KeyMode::Set, Freeze freeze = Freeze::Gather)
+        : Base(std::move(keys), mode, freeze) { initMinMax(); }
+    explicit BSTEytPrefProb(std::shared_ptr<const index_file::Mapping> map, bool verify = false)
+        : Base(std::move(map), verify) { initMinMax(); }
+
     bool contains(const Key& k) const override
     {
-        const_cast<BSTEytPrefProb*>(this)->Base::freeze();
-        const auto& a = Base::arr_;
+        const auto a = Base::keys();
         if (a.empty()) return false;
 
-        ensureMinMax();
-
-        double ratio = (max_key_ == min_key_)
-                     ? 0.5
-                     : double(k - min_key_) / double(max_key_ - min_key_);
+        const double lo = Tr::project(min_key_), hi = Tr::project(max_key_);
+        double ratio = (hi == lo) ? 0.5 : (Tr::project(k) - lo) / (hi - lo);
         ratio = std::clamp(ratio, 0.0, 1.0);
 
         std::size_t spent = 0;
@@ -92,8 +94,8 @@ public:
 
         while (i < a.size()) {
             const Key& key = a[i];
-            if (k == key) return true;
-            i = (k < key) ? 2 * i + 1 : 2 * i + 2;
+            if (Tr::equal(k, key)) return true;
+            i = Tr::less(k, key) ? 2 * i + 1 : 2 * i + 2;
         }
         return false;
     }
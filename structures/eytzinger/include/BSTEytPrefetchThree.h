@@ -2,15 +2,17 @@
 #include "BSTEyt.h"
 #include <cstddef>
 
-template<class Key>
-class BSTEytPrefThree : public BSTEyt<Key> {
-    using Base = BSTEyt<Key>;
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTEytPrefThree : public BSTEyt<Key, Alloc> {
+    using Base = BSTEyt<Key, Alloc>;
+    using Tr   = KeyTraits<Key>;
 
 public:
+    using Base::Base;
+
     bool contains(const Key& k) const override
     {
-        const_cast<BSTEytPrefThree*>(this)->Base::freeze();
-        const auto& a = Base::arr_;
+        const auto a = Base::keys();
 
         auto pf = [&](std::size_t idx) {
             if (idx < a.size()) __builtin_prefetch(&a[idx], 0, 1);
@@ -34,8 +36,8 @@ public:
             pf(2*rl + 1); pf(2*rl + 2);
             pf(2*rr + 1); pf(2*rr + 2);
 
-            if      (k == a[i]) return true;
-            else if (k <  a[i]) i = l;
+            if      (Tr::equal(k, a[i])) return true;
+            else if (Tr::less(k, a[i])) i = l;
             else                i = r;
         }
         return false;
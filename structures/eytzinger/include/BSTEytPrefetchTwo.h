@@ -2,14 +2,16 @@
 #include "BSTEyt.h"
 #include <cstddef>
 
-template<class Key>
-class BSTEytPrefTwo : public BSTEyt<Key> {
-    using Base = BSTEyt<Key>;
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTEytPrefTwo : public BSTEyt<Key, Alloc> {
+    using Base = BSTEyt<Key, Alloc>;
+    using Tr   = KeyTraits<Key>;
 
 public:
+    using Base::Base;
+
     bool contains(const Key& k) const override {
-        const_cast<BSTEytPrefTwo*>(this)->Base::freeze();
-        const auto& a = Base::arr_;
+        const auto a = Base::keys();
 
         std::size_t i = 0;
         while (i < a.size()) {
@@ -28,8 +30,8 @@ public:
             if (rl < a.size()) __builtin_prefetch(&a[rl], 0, 1);
             if (rr < a.size()) __builtin_prefetch(&a[rr], 0, 1);
 
-            if      (k == a[i]) return true;
-            else if (k <  a[i]) i = l;
+            if      (Tr::equal(k, a[i])) return true;
+            else if (Tr::less(k, a[i])) i = l;
             else                i = r;
         }
         return false;
@@ -0,0 +1,230 @@
+#pragma once
+#include "IBST.h"
+#include "BSTEytBranchless.h"
+#include "KeyTraits.h"
+#include "RadixSort.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <chrono>
+
+// Dynamic set on top of the static Eytzinger layout. Writes go to a small
+// sorted buffer; a full buffer is merged into a cascade of frozen levels
+// where level i holds at most buffer * ratio^(i+1) entries, and a level
+// that overflows is merged into the next one. Merges walk the levels in
+// order and rebuild with KeyMode::SortedSet, so they are linear. Deletes
+// are tombstones that shadow older levels until they reach the deepest
+// one. A lookup asks the buffer, then level 0, 1, ... and the first
+// source that knows the key decides.
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTLsm : public IBST<Key> {
+    using Tr    = KeyTraits<Key>;
+    using Level = BSTEytBranchless<Key, Alloc>;
+
+    struct Entry { Key key; bool dead; };
+
+    struct Run {
+        Level                     tree;
+        std::vector<std::uint8_t> dead;     // tombstone flag per Eytzinger slot
+    };
+
+    enum State : std::uint8_t { Unknown, Live, Dead };
+
+    std::size_t        buffer_, ratio_;
+    std::vector<Entry> buf_;                // sorted by key
+    std::vector<Run>   runs_;               // runs_[i] is level i, empty if unused
+
+    static bool entryLess(const Entry& e, const Key& k) { return Tr::less(e.key, k); }
+
+    std::size_t capacity(std::size_t level) const {
+        std::size_t c = buffer_;
+        for (std::size_t i = 0; i <= level; ++i) c *= ratio_;
+        return c;
+    }
+
+    Run makeRun(const std::vector<Entry>& es) const {
+        std::vector<Key> ks(es.size());
+        for (std::size_t i = 0; i < es.size(); ++i) ks[i] = es[i].key;
+
+        Run r{Level(std::move(ks), KeyMode::SortedSet), std::vector<std::uint8_t>(es.size())};
+        r.tree.set_group(this->group_);
+        std::size_t j = 0;
+        for (auto it = r.tree.begin(); it != r.tree.end(); ++it) r.dead[it.slot()] = es[j++].dead;
+        return r;
+    }
+
+    static std::vector<Entry> entries(const Run& r) {
+        std::vector<Entry> out;
+        out.reserve(r.dead.size());
+        for (auto it = r.tree.begin(); it != r.tree.end(); ++it)
+            out.push_back({*it, r.dead[it.slot()] != 0});
+        return out;
+    }
+
+    // Two-way merge of sorted runs; on equal keys the newer entry wins.
+    static std::vector<Entry> merge(const std::vector<Entry>& newer,
+                                    const std::vector<Entry>& older, bool dropDead)
+    {
+        std::vector<Entry> out;
+        out.reserve(newer.size() + older.size());
+        auto emit = [&](const Entry& e) { if (!(dropDead && e.dead)) out.push_back(e); };
+
+        std::size_t i = 0, j = 0;
+        while (i < newer.size() && j < older.size()) {
+            if      (Tr::less(newer[i].key, older[j].key)) emit(newer[i++]);
+            else if (Tr::less(older[j].key, newer[i].key)) emit(older[j++]);
+            else { emit(newer[i++]); ++j; }
+        }
+        while (i < newer.size()) emit(newer[i++]);
+        while (j < older.size()) emit(older[j++]);
+        return out;
+    }
+
+    void flush()
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<Entry> run = std::move(buf_);
+        buf_.clear();
+
+        for (std::size_t i = 0;; ++i) {
+            if (i == runs_.size()) runs_.emplace_back();
+            bool deepest = true;
+            for (std::size_t j = i + 1; j < runs_.size(); ++j) deepest &= runs_[j].dead.empty();
+
+            run = merge(run, entries(runs_[i]), deepest);
+            if (run.size() <= capacity(i)) {
+                runs_[i] = makeRun(run);
+                break;
+            }
+            runs_[i] = Run{};
+        }
+        this->stats_.layout_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+    }
+
+    void put(const Key& k, bool dead)
+    {
+        auto it = std::lower_bound(buf_.begin(), buf_.end(), k, entryLess);
+        if (it != buf_.end() && Tr::equal(it->key, k)) it->dead = dead;
+        else                                           buf_.insert(it, Entry{k, dead});
+        if (buf_.size() >= buffer_) flush();
+    }
+
+    State probeBuffer(const Key& k) const
+    {
+        auto it = std::lower_bound(buf_.begin(), buf_.end(), k, entryLess);
+        if (it == buf_.end() || !Tr::equal(it->key, k)) return Unknown;
+        return it->dead ? Dead : Live;
+    }
+
+    static State probeRun(const Run& r, std::size_t slot, const Key& k)
+    {
+        if (slot >= r.dead.size()) return Unknown;
+        if (!Tr::equal(*typename Level::const_iterator(&r.tree, slot), k)) return Unknown;
+        return r.dead[slot] ? Dead : Live;
+    }
+
+    State probe(const Key& k) const
+    {
+        State s = probeBuffer(k);
+        for (std::size_t i = 0; s == Unknown && i < runs_.size(); ++i)
+            if (!runs_[i].dead.empty())
+                s = probeRun(runs_[i], runs_[i].tree.lower_bound_pos(k), k);
+        return s;
+    }
+
+    // Smallest key >= x (> x if strict) in any source, dead or alive.
+    std::optional<Key> nextCandidate(const Key& x, bool strict) const
+    {
+        std::optional<Key> best;
+        auto consider = [&](const std::optional<Key>& c) {
+            if (c && (!best || Tr::less(*c, *best))) best = c;
+        };
+        auto it = std::lower_bound(buf_.begin(), buf_.end(), x, entryLess);
+        if (strict && it != buf_.end() && Tr::equal(it->key, x)) ++it;
+        if (it != buf_.end()) consider(it->key);
+        for (const Run& r : runs_)
+            consider(strict ? r.tree.upper_bound(x) : r.tree.lower_bound(x));
+        return best;
+    }
+
+public:
+    explicit BSTLsm(std::size_t buffer = 1024, std::size_t ratio = 4)
+        : buffer_(std::max<std::size_t>(buffer, 1)), ratio_(std::max<std::size_t>(ratio, 2)) {}
+
+    // Bulk load: all keys go to the first level that can hold them.
+    explicit BSTLsm(std::vector<Key> keys, std::size_t buffer = 1024, std::size_t ratio = 4)
+        : BSTLsm(buffer, ratio)
+    {
+        help::sortUnique(keys, KeyLess<Key>{}, KeyEqual<Key>{});
+        if (keys.empty()) return;
+
+        std::vector<Entry> es(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i) es[i] = {keys[i], false};
+        std::size_t level = 0;
+        while (capacity(level) < es.size()) ++level;
+        runs_.resize(level + 1);
+        runs_[level] = makeRun(es);
+    }
+
+    void insert(const Key& k) { put(k, false); }
+    void erase(const Key& k)  { put(k, true); }
+
+    bool contains(const Key& k) const override { return probe(k) == Live; }
+
+    // Walks the candidates in key order until one is alive in the newest
+    // source that holds it.
+    std::optional<Key> lower_bound(const Key& k) const override
+    {
+        for (auto c = nextCandidate(k, false); c; c = nextCandidate(*c, true))
+            if (probe(*c) == Live) return c;
+        return std::nullopt;
+    }
+
+    // Every level answers all still undecided keys with one batched descent.
+    void contains_batch(std::span<const Key> keys, std::span<bool> out) const override
+    {
+        std::vector<std::size_t> open;
+        std::vector<Key>         pending;
+        for (std::size_t j = 0; j < keys.size(); ++j) {
+            State s = probeBuffer(keys[j]);
+            out[j] = s == Live;
+            if (s == Unknown) { open.push_back(j); pending.push_back(keys[j]); }
+        }
+
+        std::vector<std::size_t> pos(pending.size());
+        for (const Run& r : runs_) {
+            if (pending.empty()) break;
+            if (r.dead.empty()) continue;
+            pos.resize(pending.size());
+            r.tree.lower_bound_pos_batch(pending, pos);
+
+            std::size_t m = 0;
+            for (std::size_t g = 0; g < pending.size(); ++g) {
+                State s = probeRun(r, pos[g], pending[g]);
+                if (s == Unknown) { open[m] = open[g]; pending[m] = pending[g]; ++m; }
+                else              out[open[g]] = s == Live;
+            }
+            open.resize(m);
+            pending.resize(m);
+        }
+    }
+
+    void set_group(std::size_t g) {
+        IBST<Key>::set_group(g);
+        for (Run& r : runs_) r.tree.set_group(g);
+    }
+
+    // Non-empty frozen levels.
+    std::size_t levels() const {
+        return std::count_if(runs_.begin(), runs_.end(), [](const Run& r) { return !r.dead.empty(); });
+    }
+
+    std::size_t size_bytes() const override {
+        std::size_t bytes = buf_.capacity() * sizeof(Entry);
+        for (const Run& r : runs_) bytes += r.tree.size_bytes() + r.dead.size();
+        return bytes;
+    }
+};
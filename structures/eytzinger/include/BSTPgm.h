@@ -0,0 +1,178 @@
+#pragma once
+#include "IBST.h"
+#include "KeyTraits.h"
+#include "RadixSort.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+// Learned index in the style of the PGM-index (Ferragina and Vinciguerra,
+// 2020) over the sorted key array. A piecewise linear model maps a key to
+// its position with error at most Eps; the segments are fitted greedily
+// with a shrinking cone of feasible slopes, one pass over the keys. The
+// first keys of the segments are indexed the same way with error
+// kEpsInner, level by level, until a single segment is left. A lookup
+// walks the levels top-down, each time predicting a position and
+// searching the 2*eps+3 entries around it, and ends with the same bounded
+// search in the key array. Keys must be arithmetic: the model works on
+// differences of keys.
+template<class Key, class Alloc = std::allocator<Key>, std::size_t Eps = 64>
+class BSTPgm : public IBST<Key> {
+    static_assert(std::is_arithmetic_v<Key>, "the linear model needs arithmetic keys");
+
+    static constexpr std::size_t kEpsInner = 4;
+
+    // pos(k) = base + slope * (k - key), for keys from key up to the next
+    // segment's key
+    struct Segment {
+        Key           key;
+        double        slope;
+        std::uint64_t base;
+    };
+
+    std::vector<Key, Alloc>           keys_;
+    std::vector<std::vector<Segment>> levels_;   // levels_[0] models keys_, the last has one segment
+
+    // k - from as a double; computed in the key type, so large integral keys
+    // keep the precision of their difference.
+    static double delta(const Key& k, const Key& from)
+    {
+        if constexpr (std::is_integral_v<Key>) {
+            using U = std::make_unsigned_t<Key>;
+            return k < from ? -double(U(from) - U(k)) : double(U(k) - U(from));
+        } else {
+            return double(k) - double(from);
+        }
+    }
+
+    // Greedy shrinking cone: a segment grows while some slope keeps every
+    // point of it within eps of the line through its first point.
+    template<class KeyAt>
+    static std::vector<Segment> fit(std::size_t n, KeyAt keyAt, double eps)
+    {
+        std::vector<Segment> out;
+        std::size_t i = 0;
+        while (i < n) {
+            const Key x0 = keyAt(i);
+            double lo = 0, hi = std::numeric_limits<double>::infinity();
+            std::size_t j = i + 1;
+            for (; j < n; ++j) {
+                const double dx = delta(keyAt(j), x0), dy = double(j - i);
+                if (dx <= 0) {
+                    if (dy > eps) break;
+                    continue;
+                }
+                const double l = std::max(lo, (dy - eps) / dx), h = std::min(hi, (dy + eps) / dx);
+                if (l > h) break;
+                lo = l;
+                hi = h;
+            }
+            const double slope = std::isinf(hi) ? lo : (lo + hi) / 2;
+            out.push_back({x0, slope, i});
+            i = j;
+        }
+        return out;
+    }
+
+    void build(std::vector<Key>& keys)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        help::sortUnique(keys, KeyLess<Key>{}, KeyEqual<Key>{});
+        auto t1 = std::chrono::steady_clock::now();
+
+        keys_.assign(keys.begin(), keys.end());
+        levels_.clear();
+        if (!keys_.empty()) {
+            levels_.push_back(fit(keys_.size(), [&](std::size_t i) { return keys_[i]; }, double(Eps)));
+            while (levels_.back().size() > 1) {
+                const auto& below = levels_.back();
+                levels_.push_back(fit(below.size(), [&](std::size_t i) { return below[i].key; }, double(kEpsInner)));
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        this->stats_.sort_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        this->stats_.layout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    }
+
+    // Predicted position of k by segment s of a level with n entries,
+    // clamped to the part of the level that segment covers.
+    static std::size_t predict(const std::vector<Segment>& level, std::size_t s,
+                               std::size_t n, const Key& k)
+    {
+        const Segment& seg = level[s];
+        const std::size_t end = s + 1 < level.size() ? level[s + 1].base : n;
+        const double p = double(seg.base) + seg.slope * std::max(0.0, delta(k, seg.key));
+        return p < double(end) ? std::size_t(p) : end;
+    }
+
+    // First index in [from, to) whose key is >= k, to if none.
+    template<class KeyAt>
+    static std::size_t search(std::size_t from, std::size_t to, const Key& k, KeyAt keyAt)
+    {
+        std::size_t len = to - from;
+        while (len > 0) {
+            std::size_t half = len / 2;
+            bool right = KeyTraits<Key>::less(keyAt(from + half), k);
+            from = right ? from + half + 1 : from;
+            len  = right ? len - half - 1 : half;
+        }
+        return from;
+    }
+
+    // Position of the first key >= k, keys_.size() if none.
+    std::size_t lowerBoundPos(const Key& k) const
+    {
+        const std::size_t n = keys_.size();
+        if (n == 0) return 0;
+
+        std::size_t s = 0;   // segment of the current level
+        for (std::size_t l = levels_.size(); l-- > 1; ) {
+            const auto& below = levels_[l - 1];
+            const std::size_t m = below.size();
+            const std::size_t p = predict(levels_[l], s, m, k);
+            const std::size_t from = p > kEpsInner + 1 ? p - kEpsInner - 1 : 0;
+            const std::size_t to   = std::min(m, p + kEpsInner + 2);
+            // last segment whose key is <= k: one before the first with key > k
+            std::size_t i = search(from, to, k, [&](std::size_t j) { return below[j].key; });
+            while (i < m && !KeyTraits<Key>::less(k, below[i].key)) ++i;
+            s = i ? i - 1 : 0;
+        }
+
+        const std::size_t p    = predict(levels_[0], s, n, k);
+        const std::size_t from = p > Eps + 1 ? p - Eps - 1 : 0;
+        const std::size_t to   = std::min(n, p + Eps + 2);
+        return search(from, to, k, [&](std::size_t j) { return keys_[j]; });
+    }
+
+public:
+    BSTPgm() = default;
+    explicit BSTPgm(std::vector<Key> keys) { build(keys); }
+
+    bool contains(const Key& k) const override {
+        std::size_t i = lowerBoundPos(k);
+        return i < keys_.size() && KeyTraits<Key>::equal(keys_[i], k);
+    }
+
+    std::optional<Key> lower_bound(const Key& k) const override {
+        std::size_t i = lowerBoundPos(k);
+        if (i == keys_.size()) return std::nullopt;
+        return keys_[i];
+    }
+
+    // Keys plus the model.
+    std::size_t size_bytes() const override { return keys_.size() * sizeof(Key) + model_bytes(); }
+
+    std::size_t model_bytes() const {
+        std::size_t b = 0;
+        for (const auto& l : levels_) b += l.size() * sizeof(Segment);
+        return b;
+    }
+
+    std::size_t segments() const { return levels_.empty() ? 0 : levels_[0].size(); }
+    std::size_t height()   const { return levels_.size(); }
+};
@@ -0,0 +1,223 @@
+#pragma once
+#include "IBST.h"
+#include "KeyTraits.h"
+#include "Parallel.h"
+#include "IndexFile.h"
+#include "RadixSort.h"
+#include "InPlaceLayout.h"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <span>
+#include <optional>
+#include <bit>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <type_traits>
+
+
+namespace help {
+struct PreorderTask { std::size_t lo, hi, idx; };
+
+// Writes the subtree over sorted[lo, hi) in (mid, left, right) order at
+// out[idx], with an explicit stack instead of recursion.
+template<class Key>
+void fill_preorder(Key* out, const Key* sorted, PreorderTask root)
+{
+    PreorderTask st[2 * 64];
+    std::size_t top = 0;
+    st[top++] = root;
+    while (top) {
+        PreorderTask t = st[--top];
+        if (t.lo >= t.hi) continue;
+        std::size_t mid = (t.lo + t.hi) / 2;
+        out[t.idx] = sorted[mid];
+        st[top++] = {mid + 1, t.hi, t.idx + 1 + (mid - t.lo)};
+        st[top++] = {t.lo,    mid,  t.idx + 1};
+    }
+}
+
+// The top levels are placed on the calling thread until there are a few
+// independent subtrees per core, which are then filled in parallel.
+template<class Key, class Alloc>
+void build_preorder(std::vector<Key, Alloc>& out, const std::vector<Key>& sorted)
+{
+    out.resize(sorted.size());
+    const unsigned split = std::bit_width(std::max(1u, std::thread::hardware_concurrency())) + 2;
+
+    std::vector<PreorderTask> tasks{{0, sorted.size(), 0}}, next;
+    for (unsigned d = 0; d < split && sorted.size() > (std::size_t(1) << 16); ++d) {
+        next.clear();
+        for (const PreorderTask& t : tasks) {
+            if (t.lo >= t.hi) continue;
+            std::size_t mid = (t.lo + t.hi) / 2;
+            out[t.idx] = sorted[mid];
+            next.push_back({t.lo,    mid,  t.idx + 1});
+            next.push_back({mid + 1, t.hi, t.idx + 1 + (mid - t.lo)});
+        }
+        tasks.swap(next);
+    }
+
+    parallel_for(tasks.size(), [&](std::size_t b, std::size_t e) {
+        for (std::size_t i = b; i < e; ++i) fill_preorder(out.data(), sorted.data(), tasks[i]);
+    }, 1);
+}
+} 
+
+// Sorted keys in preorder, (mid, left, right): a node's left subtree
+// follows it directly and its right subtree after that, so the position of
+// a child follows from the size of the range. The top of the tree is
+// contiguous, but a deep search jumps by half the remaining range at every
+// level; see BSTVEB for the height-split layout.
+template<class Key, class Alloc = std::allocator<Key>>
+class BSTPreorder : public IBST<Key> {
+    using Tr = KeyTraits<Key>;
+
+    std::vector<Key, Alloc> arr_;     
+
+    // Set when the tree was opened from an index file (see BSTEyt).
+    std::shared_ptr<const index_file::Mapping> map_;
+    std::span<const Key>                       mapped_;
+
+    std::span<const Key> keys() const {
+        return map_ ? mapped_ : std::span<const Key>(arr_);
+    }
+
+
+    // In place only with the plain allocator, as in BSTEyt::build.
+    void build(std::vector<Key>& keys, Freeze freeze) {
+        const bool inPlace = freeze == Freeze::InPlace && std::is_same_v<Alloc, std::allocator<Key>>;
+        auto t0 = std::chrono::steady_clock::now();
+        help::sortUnique(keys, KeyLess<Key>{}, KeyEqual<Key>{}, inPlace);
+        auto t1 = std::chrono::steady_clock::now();
+
+        if constexpr (std::is_same_v<Alloc, std::allocator<Key>>) {
+            if (inPlace) {
+                help::preorderInPlace(keys.data(), keys.size());
+                arr_ = std::move(keys);
+            } else {
+                help::build_preorder(arr_, keys);
+            }
+        } else {
+            help::build_preorder(arr_, keys);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        this->stats_.sort_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        this->stats_.layout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    }
+
+    static bool containsRec(std::span<const Key> a, const Key& k,
+                            std::size_t lo, std::size_t hi, std::size_t idx)
+    {
+        if (lo >= hi) return false;            
+
+        const Key& key = a[idx];
+        if (Tr::equal(k, key)) return true;
+
+        std::size_t mid        = (lo + hi) / 2;
+        std::size_t left_size  = mid - lo;    
+        std::size_t left_idx   = idx + 1;   
+        std::size_t right_idx  = idx + 1 + left_size;
+
+        return Tr::less(k, key)
+             ? containsRec(a, k, lo, mid,           left_idx)
+             : containsRec(a, k, mid + 1, hi,       right_idx);
+    }
+
+    // Lockstep version of the (lo, hi, idx) descent used by containsRec for
+    // group_ keys at a time. The last node where a lane went left is its
+    // lower_bound; emit receives that slot or keys().size() if there is none.
+    template<class Emit>
+    void lowerBoundBatch(std::span<const Key> keys, Emit emit) const
+    {
+        const auto a = this->keys();
+        const std::size_t n = a.size();
+        const std::size_t G = this->group_;
+        const unsigned depth = std::bit_width(n);
+        std::size_t lo[IBST<Key>::kMaxGroup], hi[IBST<Key>::kMaxGroup];
+        std::size_t idx[IBST<Key>::kMaxGroup], cand[IBST<Key>::kMaxGroup];
+
+        for (std::size_t base = 0; base < keys.size(); base += G) {
+            const std::size_t m = std::min(G, keys.size() - base);
+            const Key* kb = keys.data() + base;
+            for (std::size_t g = 0; g < m; ++g) {
+                lo[g] = 0; hi[g] = n; idx[g] = 0; cand[g] = n;
+            }
+
+            for (unsigned d = 0; d < depth; ++d) {
+                for (std::size_t g = 0; g < m; ++g) {
+                    if (lo[g] >= hi[g]) continue;
+                    std::size_t mid  = (lo[g] + hi[g]) / 2;
+                    std::size_t left = mid - lo[g];
+                    bool go_left = !Tr::less(a[idx[g]], kb[g]);
+                    cand[g] = go_left ? idx[g] : cand[g];
+                    lo[g]   = go_left ? lo[g] : mid + 1;
+                    hi[g]   = go_left ? mid   : hi[g];
+                    idx[g] += go_left ? 1     : 1 + left;
+                    __builtin_prefetch(a.data() + idx[g], 0, 1);
+                }
+            }
+            for (std::size_t g = 0; g < m; ++g) emit(base + g, cand[g]);
+        }
+    }
+
+public:
+    BSTPreorder() = default;
+    explicit BSTPreorder(std::vector<Key> keys, Freeze freeze = Freeze::Gather) { build(keys, freeze); }
+    explicit BSTPreorder(std::shared_ptr<const index_file::Mapping> map, bool verify = false)
+        : map_(std::move(map)),
+          mapped_(map_->template keys<Key>(index_file::Layout::Preorder, verify)) {}
+
+    bool contains(const Key& k) const override {
+        const auto a = keys();
+        return containsRec(a, k, 0, a.size(), 0);
+    }
+
+    std::optional<Key> lower_bound(const Key& k) const override {
+        const auto a = keys();
+        std::size_t lo = 0, hi = a.size(), idx = 0;
+        std::optional<Key> cand;
+        while (lo < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (Tr::less(a[idx], k)) {
+                idx += 1 + (mid - lo);
+                lo   = mid + 1;
+            } else {
+                cand = a[idx];
+                idx += 1;
+                hi   = mid;
+            }
+        }
+        return cand;
+    }
+
+    void contains_batch(std::span<const Key> keys,
+                        std::span<bool>      out) const override
+    {
+        const auto a = this->keys();
+        lowerBoundBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = i < a.size() && Tr::equal(a[i], keys[j]);
+        });
+    }
+
+    void lower_bound_batch(std::span<const Key>          keys,
+                           std::span<std::optional<Key>> out) const override
+    {
+        const auto a = this->keys();
+        lowerBoundBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = (i < a.size()) ? std::optional<Key>(a[i]) : std::nullopt;
+        });
+    }
+
+     std::size_t size_bytes() const override { return keys().size() * sizeof(Key); }
+
+    void save(const std::string& path) const {
+        index_file::write<Key>(path, index_file::Layout::Preorder, keys());
+    }
+
+    template<class Tree = BSTPreorder>
+    static Tree open(const std::string& path, bool verify = false) {
+        return Tree(std::make_shared<const index_file::Mapping>(path), verify);
+    }
+};
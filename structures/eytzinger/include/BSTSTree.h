@@ -0,0 +1,116 @@
+#pragma once
+#include "IBST.h"
+#include "AlignedAllocator.h"
+#include "KeyTraits.h"
+#include "Parallel.h"
+#include "RadixSort.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <chrono>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Static B+-tree (S+-tree): every node is one cache line of B sorted keys,
+// the leaf layer holds all keys in order and each internal key is the
+// smallest key of the subtree to its right. Layers are stored bottom-up and
+// children are found by arithmetic, so there are no pointers at all.
+// Alloc has to hand out 64-byte aligned storage for the aligned SIMD loads.
+template<class Key, class Alloc = AlignedAllocator<Key>>
+class BSTSTree : public IBST<Key> {
+    static constexpr std::size_t B = std::max<std::size_t>(64 / sizeof(Key), 2);
+    using Tr = KeyTraits<Key>;
+
+    std::vector<Key, Alloc>                 t_;
+    std::vector<std::size_t>                off_;     // start of every layer
+    std::size_t                             n_ = 0;
+
+    static std::size_t blocks(std::size_t n)    { return (n + B - 1) / B; }
+    static std::size_t prevKeys(std::size_t n)  { return (blocks(n) + B) / (B + 1) * B; }
+
+    void build(std::vector<Key>& keys_in)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        help::sortUnique(keys_in, KeyLess<Key>{}, KeyEqual<Key>{});
+        n_ = keys_in.size();
+        auto t1 = std::chrono::steady_clock::now();
+
+        off_.assign(1, 0);
+        std::size_t keys  = n_;
+        std::size_t total = std::max<std::size_t>(blocks(keys), 1) * B;
+        while (keys > B) {
+            keys = prevKeys(keys);
+            off_.push_back(total);
+            total += blocks(keys) * B;
+        }
+
+        const Key pad = Tr::max();
+        t_.assign(total, pad);
+        help::parallel_for(n_, [&](std::size_t b, std::size_t e) {
+            std::copy(keys_in.begin() + b, keys_in.begin() + e, t_.begin() + b);
+        });
+
+        for (std::size_t h = 1; h < off_.size(); ++h) {
+            std::size_t layer = (h + 1 < off_.size() ? off_[h + 1] : total) - off_[h];
+            help::parallel_for(layer, [&](std::size_t b, std::size_t e) {
+                for (std::size_t i = b; i < e; ++i) {
+                    std::size_t k = i / B * (B + 1) + i % B + 1;
+                    for (std::size_t l = 1; l < h; ++l) k *= B + 1;
+                    t_[off_[h] + i] = (k * B < n_) ? t_[k * B] : pad;
+                }
+            });
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        this->stats_.sort_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        this->stats_.layout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    }
+
+    // number of keys in the node that are smaller than x
+    static unsigned rank(const Key* node, const Key& x)
+    {
+        if constexpr (std::is_same_v<Key, std::int32_t> && B == 16) {
+#if defined(__AVX512F__)
+            __m512i v = _mm512_load_si512(node);
+            return __builtin_popcount(_mm512_cmplt_epi32_mask(v, _mm512_set1_epi32(x)));
+#elif defined(__AVX2__)
+            __m256i xv = _mm256_set1_epi32(x);
+            __m256i lo = _mm256_cmpgt_epi32(xv, _mm256_load_si256((const __m256i*)node));
+            __m256i hi = _mm256_cmpgt_epi32(xv, _mm256_load_si256((const __m256i*)(node + 8)));
+            unsigned m = _mm256_movemask_ps(_mm256_castsi256_ps(lo))
+                       | _mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+            return __builtin_popcount(m);
+#endif
+        }
+        unsigned r = 0;
+        for (std::size_t j = 0; j < B; ++j) r += Tr::less(node[j], x);
+        return r;
+    }
+
+    // position of the first key >= x in the leaf layer, n_ if there is none
+    std::size_t lowerBoundIdx(const Key& x) const
+    {
+        std::size_t k = 0;
+        for (std::size_t h = off_.size() - 1; h > 0; --h)
+            k = k * (B + 1) + rank(t_.data() + off_[h] + k, x) * B;
+        return std::min(k + rank(t_.data() + k, x), n_);
+    }
+
+public:
+    BSTSTree() : BSTSTree(std::vector<Key>{}) {}
+    explicit BSTSTree(std::vector<Key> keys) { build(keys); }
+
+    bool contains(const Key& k) const override {
+        std::size_t i = lowerBoundIdx(k);
+        return i < n_ && Tr::equal(t_[i], k);
+    }
+
+    std::optional<Key> lower_bound(const Key& k) const override {
+        std::size_t i = lowerBoundIdx(k);
+        if (i == n_) return std::nullopt;
+        return t_[i];
+    }
+
+    std::size_t size_bytes() const override { return t_.size() * sizeof(Key); }
+};
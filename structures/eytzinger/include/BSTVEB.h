@@ -1,71 +1,176 @@
 #pragma once
 #include "IBST.h"
+#include "KeyTraits.h"
+#include "IndexFile.h"
+#include "RadixSort.h"
+#include "VebLayout.h"
+#include "InPlaceLayout.h"
 #include <vector>
+#include <memory>
 #include <algorithm>
-#include <stdexcept>
-
-
-namespace help {
-template<class Key>
-void build_veb(std::vector<Key>& out,
-               const std::vector<Key>& sorted, std::size_t lo, std::size_t hi)
-{
-    if (lo >= hi) return;                       
-    std::size_t mid = (lo + hi) / 2;            
-    out.push_back(sorted[mid]);                 
-    build_veb(out, sorted, lo, mid);            
-    build_veb(out, sorted, mid + 1, hi);        
-}
-} 
-
-template<class Key>
+#include <span>
+#include <optional>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Keys in the height-split van Emde Boas layout (see VebLayout.h): any
+// root-to-leaf path crosses O(log n / log B) blocks of B keys for every
+// block size B at once, where the preorder layout of BSTPreorder only keeps
+// the top of the tree together.
+template<class Key, class Alloc = std::allocator<Key>>
 class BSTVEB : public IBST<Key> {
-    std::vector<Key> a_;            
-    bool              frozen_ = false;
-    std::vector<Key>  inserts_;     
+    using Tr = KeyTraits<Key>;
 
+    std::vector<Key, Alloc> arr_;
 
-    void freeze() {
-        if (frozen_) return;
+    // Set when the tree was opened from an index file (see BSTEyt).
+    std::shared_ptr<const index_file::Mapping> map_;
+    std::span<const Key>                       mapped_;
 
-        std::sort(inserts_.begin(), inserts_.end());
-        inserts_.erase(std::unique(inserts_.begin(), inserts_.end()),
-                       inserts_.end());
+    help::VebTables tables_;   // after mapped_, which sizes them on open
+    std::uint64_t   far_ = tables_.farLevels(sizeof(Key));
 
-        a_.reserve(inserts_.size());
-        help::build_veb(a_, inserts_, 0, inserts_.size());
-        frozen_ = true;
+    std::span<const Key> keys() const {
+        return map_ ? mapped_ : std::span<const Key>(arr_);
     }
 
-    bool containsRec(const Key& k,
-                     std::size_t lo, std::size_t hi, std::size_t idx) const
+    // In place only with the plain allocator, as in BSTEyt::build.
+    void build(std::vector<Key>& keys, Freeze freeze) {
+        const bool inPlace = freeze == Freeze::InPlace && std::is_same_v<Alloc, std::allocator<Key>>;
+        auto t0 = std::chrono::steady_clock::now();
+        help::sortUnique(keys, KeyLess<Key>{}, KeyEqual<Key>{}, inPlace);
+        auto t1 = std::chrono::steady_clock::now();
+        tables_ = help::VebTables(std::bit_width(keys.size()));
+        far_    = tables_.farLevels(sizeof(Key));
+
+        if constexpr (std::is_same_v<Alloc, std::allocator<Key>>) {
+            if (inPlace) {
+                help::vebInPlace(keys.data(), keys.size(), tables_);
+                arr_ = std::move(keys);
+            } else {
+                help::build_veb(arr_, keys, tables_);
+            }
+        } else {
+            help::build_veb(arr_, keys, tables_);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        this->stats_.sort_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        this->stats_.layout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    }
+
+    // Position of the first key >= k, keys().size() if none: the last node
+    // where the descent went left. Where the cut two levels down leaves the
+    // current cache line, the grandchildren are prefetched before the
+    // comparison, so the next block is on its way while this one is read.
+    std::size_t lowerBoundPos(const Key& k) const
     {
-        if (lo >= hi) return false;            
+        const auto a = keys();
+        const std::size_t n = a.size();
+        const unsigned    h = tables_.height;
+        std::size_t path[64];
+        std::size_t cand = n, p = 0, i = 1;
+        path[0] = 0;
+        for (unsigned d = 0; n; ) {
+            if (d + 2 < h && (far_ >> (d + 2)) & 1)
+                tables_.prefetchGrandchildren(a.data(), n, path, d, i);
+            const bool right = Tr::less(a[p], k);
+            cand = right ? cand : p;
+            if (++d == h) break;
+            i = 2*i + right;
+            p = tables_.pos(path, d, i);
+            if (p >= n) break;
+            path[d] = p;
+        }
+        return cand;
+    }
 
-        const Key& key = a_[idx];
-        if (k == key) return true;
+    // lowerBoundPos for group_ keys at a time, the lanes in lockstep, each
+    // prefetching its next node; a lane whose child does not exist is done
+    // (p == n). emit receives the lower_bound slot or keys().size().
+    template<class Emit>
+    void lowerBoundBatch(std::span<const Key> keys, Emit emit) const
+    {
+        const auto a = this->keys();
+        const std::size_t n = a.size();
+        const std::size_t G = this->group_;
+        std::size_t path[IBST<Key>::kMaxGroup][64];
+        std::size_t p[IBST<Key>::kMaxGroup], idx[IBST<Key>::kMaxGroup], cand[IBST<Key>::kMaxGroup];
 
-        std::size_t mid        = (lo + hi) / 2;
-        std::size_t left_size  = mid - lo;    
-        std::size_t left_idx   = idx + 1;   
-        std::size_t right_idx  = idx + 1 + left_size;
+        for (std::size_t base = 0; base < keys.size(); base += G) {
+            const std::size_t m = std::min(G, keys.size() - base);
+            const Key* kb = keys.data() + base;
+            for (std::size_t g = 0; g < m; ++g) {
+                p[g] = 0; idx[g] = 1; cand[g] = n; path[g][0] = 0;
+            }
 
-        return (k < key)
-             ? containsRec(k, lo, mid,           left_idx)
-             : containsRec(k, mid + 1, hi,       right_idx);
+            for (unsigned d = 1; d <= tables_.height; ++d) {
+                for (std::size_t g = 0; g < m; ++g) {
+                    if (p[g] >= n) continue;
+                    const bool right = Tr::less(a[p[g]], kb[g]);
+                    cand[g] = right ? cand[g] : p[g];
+                    if (d == tables_.height) continue;
+                    idx[g]  = 2*idx[g] + right;
+                    p[g]    = tables_.pos(path[g], d, idx[g]);
+                    path[g][d] = p[g];
+                    __builtin_prefetch(a.data() + std::min(p[g], n - 1), 0, 1);
+                }
+            }
+            for (std::size_t g = 0; g < m; ++g) emit(base + g, cand[g]);
+        }
     }
 
 public:
-    void insert(const Key& k) override {
-        if (frozen_)
-            throw std::logic_error("I am already frozen!");
-        inserts_.push_back(k);
-    }
+    BSTVEB() = default;
+    explicit BSTVEB(std::vector<Key> keys, Freeze freeze = Freeze::Gather) { build(keys, freeze); }
+    explicit BSTVEB(std::shared_ptr<const index_file::Mapping> map, bool verify = false)
+        : map_(std::move(map)),
+          mapped_(map_->template keys<Key>(index_file::Layout::Veb, verify)),
+          tables_(std::bit_width(mapped_.size())) {}
 
     bool contains(const Key& k) const override {
-        const_cast<BSTVEB*>(this)->freeze();   
-        return containsRec(k, 0, a_.size(), 0);
+        const auto a = keys();
+        std::size_t p = lowerBoundPos(k);
+        return p < a.size() && Tr::equal(a[p], k);
+    }
+
+    std::optional<Key> lower_bound(const Key& k) const override {
+        const auto a = keys();
+        std::size_t p = lowerBoundPos(k);
+        if (p == a.size()) return std::nullopt;
+        return a[p];
+    }
+
+    void contains_batch(std::span<const Key> keys,
+                        std::span<bool>      out) const override
+    {
+        const auto a = this->keys();
+        lowerBoundBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = i < a.size() && Tr::equal(a[i], keys[j]);
+        });
+    }
+
+    void lower_bound_batch(std::span<const Key>          keys,
+                           std::span<std::optional<Key>> out) const override
+    {
+        const auto a = this->keys();
+        lowerBoundBatch(keys, [&](std::size_t j, std::size_t i) {
+            out[j] = (i < a.size()) ? std::optional<Key>(a[i]) : std::nullopt;
+        });
     }
 
-     std::size_t size_bytes() const override { return a_.size() * sizeof(Key); }
+    std::size_t size_bytes() const override { return keys().size() * sizeof(Key); }
+
+    unsigned height() const { return tables_.height; }
+
+    void save(const std::string& path) const {
+        index_file::write<Key>(path, index_file::Layout::Veb, keys());
+    }
+
+    template<class Tree = BSTVEB>
+    static Tree open(const std::string& path, bool verify = false) {
+        return Tree(std::make_shared<const index_file::Mapping>(path), verify);
+    }
 };
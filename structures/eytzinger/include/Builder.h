@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// Mutable front end of the immutable trees: collects keys in any order
+// (duplicates allowed) and hands them to the tree's constructor, which
+// sorts, dedups and lays them out once.
+template<class Tree>
+class Builder {
+public:
+    using Key = typename Tree::key_type;
+
+    Builder() = default;
+    explicit Builder(std::size_t expected) { keys_.reserve(expected); }
+
+    void insert(const Key& k) { keys_.push_back(k); }
+    std::size_t size() const  { return keys_.size(); }
+
+    // Consumes the collected keys; the builder is empty afterwards. Extra
+    // arguments are passed on to the tree (e.g. KeyMode::Multiset).
+    template<class... Opts>
+    Tree build(Opts&&... opts) {
+        return Tree(std::exchange(keys_, {}), std::forward<Opts>(opts)...);
+    }
+
+private:
+    std::vector<Key> keys_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace help {
+
+// Data cache sizes of the CPU we run on, in bytes.
+struct CacheSizes {
+    std::size_t l1   = 32u << 10;
+    std::size_t l2   = 1u << 20;
+    std::size_t l3   = 32u << 20;
+    std::size_t line = 64;
+};
+
+// "48K", "2048K", "32M" as bytes; 0 if unreadable.
+inline std::size_t parseCacheSize(const std::string& s)
+{
+    std::size_t pos = 0, v = 0;
+    try { v = std::stoull(s, &pos); } catch (...) { return 0; }
+    if (pos < s.size()) {
+        if (s[pos] == 'K') v <<= 10;
+        else if (s[pos] == 'M') v <<= 20;
+        else if (s[pos] == 'G') v <<= 30;
+    }
+    return v;
+}
+
+// Read once from /sys/devices/system/cpu/cpu0/cache, falling back to
+// sysconf and then to the defaults above for what is missing.
+inline const CacheSizes& cacheSizes()
+{
+    static const CacheSizes sizes = [] {
+        CacheSizes c;
+        std::size_t found[4] = {};
+        for (int idx = 0; idx < 16; ++idx) {
+            const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(idx) + "/";
+            std::ifstream lf(dir + "level"), tf(dir + "type"), sf(dir + "size"), cf(dir + "coherency_line_size");
+            int level = 0;
+            std::string type, size;
+            if (!(lf >> level) || !(tf >> type) || !(sf >> size)) break;
+            if (type == "Instruction" || level < 1 || level > 3) continue;
+            found[level] = parseCacheSize(size);
+            std::size_t line = 0;
+            if (level == 1 && (cf >> line) && line) c.line = line;
+        }
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+        const long sc[4] = {0, sysconf(_SC_LEVEL1_DCACHE_SIZE), sysconf(_SC_LEVEL2_CACHE_SIZE), sysconf(_SC_LEVEL3_CACHE_SIZE)};
+        for (int l = 1; l <= 3; ++l)
+            if (!found[l] && sc[l] > 0) found[l] = static_cast<std::size_t>(sc[l]);
+#endif
+        if (found[1]) c.l1 = found[1];
+        if (found[2]) c.l2 = found[2];
+        if (found[3]) c.l3 = found[3];
+        return c;
+    }();
+    return sizes;
+}
+
+}
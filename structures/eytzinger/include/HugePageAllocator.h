@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <sys/mman.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace huge_detail {
+// Lengths of the live 1GB-page mappings. Only the 1GB attempt rounds the
+// request to whole 1GB pages; every other mapping is rounded to 2MB, and
+// deallocate has to unmap the length that was actually mapped.
+inline std::mutex                                    gigLock;
+inline std::unordered_map<std::uintptr_t, std::size_t> gigMappings;
+}
+
+// Allocator for the frozen arrays that backs them with huge pages. Large
+// requests try, in order, explicit 1GB pages (only for >= 1GB), explicit
+// 2MB pages (MAP_HUGETLB, needs a reserved pool in /proc/sys/vm/nr_hugepages)
+// and finally a 2MB-aligned anonymous mapping marked MADV_HUGEPAGE for
+// transparent huge pages, which degrades to 4K pages if THP is disabled.
+// Requests below half a huge page are served from the heap, 64-byte aligned.
+template<class T>
+struct HugePageAllocator {
+    using value_type = T;
+
+    static constexpr std::size_t kHuge2M = std::size_t(1) << 21;
+    static constexpr std::size_t kHuge1G = std::size_t(1) << 30;
+    static constexpr std::size_t kAlign  = 64;
+
+    HugePageAllocator() = default;
+    template<class U>
+    HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+    static std::size_t roundUp(std::size_t bytes, std::size_t page)
+    {
+        return (bytes + page - 1) / page * page;
+    }
+
+    T* allocate(std::size_t n)
+    {
+        std::size_t bytes = n * sizeof(T);
+        if (bytes < kHuge2M / 2)
+            return static_cast<T*>(::operator new(bytes ? bytes : 1, std::align_val_t(kAlign)));
+
+        const std::size_t len  = roundUp(bytes, kHuge2M);
+        const int         prot = PROT_READ | PROT_WRITE;
+        const int         anon = MAP_PRIVATE | MAP_ANONYMOUS;
+        void* p = MAP_FAILED;
+
+        if (bytes >= kHuge1G) {
+            const std::size_t gig = roundUp(bytes, kHuge1G);
+            p = mmap(nullptr, gig, prot, anon | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+            if (p != MAP_FAILED) {
+                std::lock_guard<std::mutex> lock(huge_detail::gigLock);
+                huge_detail::gigMappings[reinterpret_cast<std::uintptr_t>(p)] = gig;
+                return static_cast<T*>(p);
+            }
+        }
+        p = mmap(nullptr, len, prot, anon | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) return static_cast<T*>(p);
+
+        // over-map by one huge page so the range can be trimmed to 2MB alignment
+        void* raw = mmap(nullptr, len + kHuge2M, prot, anon, -1, 0);
+        if (raw == MAP_FAILED) throw std::bad_alloc();
+        auto base  = reinterpret_cast<std::uintptr_t>(raw);
+        auto start = (base + kHuge2M - 1) & ~(kHuge2M - 1);
+        if (start > base) munmap(raw, start - base);
+        munmap(reinterpret_cast<void*>(start + len), base + kHuge2M - start);
+        madvise(reinterpret_cast<void*>(start), len, MADV_HUGEPAGE);
+        return reinterpret_cast<T*>(start);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        std::size_t bytes = n * sizeof(T);
+        if (bytes < kHuge2M / 2) {
+            ::operator delete(p, std::align_val_t(kAlign));
+            return;
+        }
+        std::size_t len = roundUp(bytes, kHuge2M);
+        if (bytes >= kHuge1G) {
+            std::lock_guard<std::mutex> lock(huge_detail::gigLock);
+            auto it = huge_detail::gigMappings.find(reinterpret_cast<std::uintptr_t>(p));
+            if (it != huge_detail::gigMappings.end()) {
+                len = it->second;
+                huge_detail::gigMappings.erase(it);
+            }
+        }
+        munmap(p, len);
+    }
+
+    template<class U>
+    bool operator==(const HugePageAllocator<U>&) const noexcept { return true; }
+};
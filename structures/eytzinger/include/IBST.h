@@ -1,11 +1,48 @@
 #pragma once
 #include <cstddef>
+#include <optional>
+#include <span>
+#include <algorithm>
 
+// Wall time of the two phases of building a tree: sort + dedup of the
+// collected keys and writing the final layout.
+struct BuildStats {
+    long long sort_ns   = 0;
+    long long layout_ns = 0;
+};
+
+// Read-only interface of a built index. Trees are constructed from their
+// complete key set (see Builder.h) and never change afterwards, so every
+// const member is safe to call from any number of threads at once.
 template<class Key>
 class IBST {
+protected:
+    static constexpr std::size_t kMaxGroup = 64;
+    std::size_t group_ = 16;    // descents run in lockstep by the batch calls
+    BuildStats  stats_;
+
 public:
-    virtual void insert(const Key& k)                = 0;
+    using key_type = Key;
+
     virtual bool contains(const Key& k)        const = 0;
+    virtual std::optional<Key> lower_bound(const Key& k) const = 0;
     virtual std::size_t size_bytes()     const = 0;
+
+    virtual void contains_batch(std::span<const Key> keys,
+                                std::span<bool>      out) const
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i) out[i] = contains(keys[i]);
+    }
+    virtual void lower_bound_batch(std::span<const Key>              keys,
+                                   std::span<std::optional<Key>>     out) const
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i) out[i] = lower_bound(keys[i]);
+    }
+
+    void set_group(std::size_t g) { group_ = std::clamp<std::size_t>(g, 1, kMaxGroup); }
+    std::size_t group() const     { return group_; }
+
+    const BuildStats& build_stats() const { return stats_; }
+
     virtual ~IBST() = default;
 };
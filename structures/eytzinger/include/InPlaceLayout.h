@@ -0,0 +1,168 @@
+#pragma once
+#include "Parallel.h"
+#include "VebLayout.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// How a tree turns its sorted keys into its layout. Gather writes a second
+// array from the sorted one in parallel, which holds 2x the key bytes at
+// the peak; InPlace permutes the sorted keys where they are, with O(log n)
+// extra space and O(n log n) moves, and the tree then keeps that buffer.
+enum class Freeze { Gather, InPlace };
+
+namespace help {
+
+// Stable partition of a[0, 2m) by position: a[1], a[3], ..., a[2m-1]
+// first, then a[0], a[2], ..., a[2m-2]. Both halves are done recursively
+// and the middle two blocks swapped with a rotation; below the top
+// log2(threads) levels on one thread.
+template<class Key>
+void oddsFirst(Key* a, std::size_t m, unsigned threads = 1)
+{
+    if (m <= 1) {
+        if (m == 1) std::swap(a[0], a[1]);
+        return;
+    }
+    const std::size_t h = m / 2;
+    if (threads > 1 && m > (std::size_t(1) << 16)) {
+        std::thread left([=] { oddsFirst(a, h, threads / 2); });
+        oddsFirst(a + 2*h, m - h, threads - threads / 2);
+        left.join();
+    } else {
+        oddsFirst(a, h);
+        oddsFirst(a + 2*h, m - h);
+    }
+    // [O1 E1][O2 E2] -> [O1 O2][E1 E2]
+    std::rotate(a + h, a + 2*h, a + 2*h + (m - h));
+}
+
+// Sorted a[0, n) to the 0-based Eytzinger layout of BSTEyt, in place. The
+// deepest level is last in that layout and, in key order, holds every
+// other key: for a perfect tree the keys at even positions, for a partial
+// last level of L nodes those at 0, 2, ..., 2L-2. Moving them behind the
+// rest leaves the sorted keys of a perfect tree one level lower in front,
+// which is peeled the same way until one node is left.
+template<class Key>
+void eytzingerInPlace(Key* a, std::size_t n)
+{
+    if (n < 2) return;
+    const unsigned    threads = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t perfect = (std::size_t(1) << (std::bit_width(n + 1) - 1)) - 1;
+    const std::size_t L       = n - perfect;
+    if (L) {
+        oddsFirst(a, L, threads);               // [inner L][deepest L][rest]
+        std::rotate(a + L, a + 2*L, a + n);     // [inner L][rest][deepest L]
+    }
+    for (std::size_t p = perfect; p > 1; p = (p - 1) / 2)
+        oddsFirst(a, (p - 1) / 2, threads);     // the last key stays last
+}
+
+// Sorted a[lo, hi) to the (mid, left, right) order of BSTPreorder, in place.
+// Rotating the middle key to the front leaves the left keys behind it and
+// the right keys after them, both still sorted. The top levels run on the
+// calling thread until there are a few subtrees per core, which are then
+// done in parallel (as in build_preorder).
+template<class Key>
+void preorderInPlace(Key* a, std::size_t n)
+{
+    struct Range { std::size_t lo, hi; };
+    auto run = [a](Range root) {
+        Range st[2 * 64];
+        std::size_t top = 0;
+        st[top++] = root;
+        while (top) {
+            Range r = st[--top];
+            if (r.hi - r.lo < 2) continue;
+            std::size_t mid = (r.lo + r.hi) / 2;
+            std::rotate(a + r.lo, a + mid, a + mid + 1);
+            st[top++] = {mid + 1,  r.hi};
+            st[top++] = {r.lo + 1, mid + 1};
+        }
+    };
+
+    const unsigned split = std::bit_width(std::max(1u, std::thread::hardware_concurrency())) + 2;
+    std::vector<Range> tasks{{0, n}}, next;
+    for (unsigned d = 0; d < split && n > (std::size_t(1) << 16); ++d) {
+        next.clear();
+        for (const Range& r : tasks) {
+            if (r.hi - r.lo < 2) continue;
+            std::size_t mid = (r.lo + r.hi) / 2;
+            std::rotate(a + r.lo, a + mid, a + mid + 1);
+            next.push_back({r.lo + 1, mid + 1});
+            next.push_back({mid + 1,  r.hi});
+        }
+        tasks.swap(next);
+    }
+    parallel_for(tasks.size(), [&](std::size_t b, std::size_t e) {
+        for (std::size_t i = b; i < e; ++i) run(tasks[i]);
+    }, 1);
+}
+
+// Stable partition of g groups of s keys by position: the last key of
+// every group first, then the others in order. As in oddsFirst (s = 2),
+// both halves are done recursively and the middle two blocks rotated.
+template<class Key>
+void lastsFirst(Key* a, std::size_t g, std::size_t s, unsigned threads = 1)
+{
+    if (g <= 1) {
+        if (g == 1) std::rotate(a, a + s - 1, a + s);
+        return;
+    }
+    const std::size_t h = g / 2;
+    if (threads > 1 && g * s > (std::size_t(1) << 16)) {
+        std::thread left([=] { lastsFirst(a, h, s, threads / 2); });
+        lastsFirst(a + h*s, g - h, s, threads - threads / 2);
+        left.join();
+    } else {
+        lastsFirst(a, h, s);
+        lastsFirst(a + h*s, g - h, s);
+    }
+    // [L1 R1][L2 R2] -> [L1 L2][R1 R2]
+    std::rotate(a + h, a + h*s, a + h*s + (g - h));
+}
+
+// Sorted a[0, m) to the layout of the subtree of height h rooted at depth
+// root, in place. In key order a cut reads bottom 0, top 0, bottom 1,
+// top 1, ..., the bottoms before the last one full (see build_veb), so
+// the top keys are the last of every group of B + 1 and, after the last
+// partial bottom, a sorted tail. Moving them in front of the bottoms
+// leaves every subtree of the cut sorted in its own slots, which are then
+// permuted the same way; the bottoms of a large cut in parallel.
+template<class Key>
+void vebSubtreeInPlace(Key* a, std::size_t m, const VebTables& t, unsigned root, unsigned h,
+                       unsigned threads = 1)
+{
+    for (; h >= 2 && m >= 2; h /= 2) {
+        const unsigned    ht = h / 2;
+        const std::size_t T  = t.level[root + ht].topSize, B = t.level[root + ht].botSize;
+        if (m <= T) continue;                           // only the top has keys
+
+        const std::size_t g = std::min((m - T) / B, T);
+        lastsFirst(a, g, B + 1, threads);              // [g tops][g bottoms][rest][T - g tops]
+        std::rotate(a + g, a + g + (m - T), a + m);     // [T tops][bottoms]
+        vebSubtreeInPlace(a, T, t, root, ht);
+
+        const std::size_t subtrees = (m - T + B - 1) / B;
+        auto bottoms = [&](std::size_t b, std::size_t e) {
+            for (std::size_t j = b; j < e; ++j)
+                vebSubtreeInPlace(a + T + j*B, std::min(B, m - T - j*B), t, root + ht, h - ht);
+        };
+        if (threads > 1 && m > (std::size_t(1) << 16)) parallel_for(subtrees, bottoms, 1);
+        else                                           bottoms(0, subtrees);
+        return;
+    }
+}
+
+// Sorted a[0, n) to the height-split layout of BSTVEB (n keys in the first
+// n slots of the perfect tree of height t.height), in place: O(n log n)
+// moves and O(log n) stack.
+template<class Key>
+void vebInPlace(Key* a, std::size_t n, const VebTables& t)
+{
+    vebSubtreeInPlace(a, n, t, 0, t.height, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "KeyTraits.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk format of a frozen layout: a 64-byte header followed by the key
+// array exactly as it sits in memory, so a mapping of the file can be
+// queried in place.
+namespace index_file {
+
+constexpr char          kMagic[8] = {'E', 'Y', 'T', 'Z', 'I', 'D', 'X', '\0'};
+constexpr std::uint32_t kVersion  = 2;   // 2: Veb is the height-split layout
+
+enum class Layout : std::uint32_t { Eytzinger = 1, Veb = 2, Preorder = 3 };
+
+struct Header {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t layout;
+    std::uint32_t key_type;
+    std::uint32_t key_size;
+    std::uint64_t n;
+    std::uint64_t checksum;     // FNV-1a over the key bytes
+    std::uint8_t  reserved[24];
+};
+static_assert(sizeof(Header) == 64, "keys must start on a cache line");
+
+template<class T> struct KeyTag { static constexpr std::uint32_t value = 0; };
+template<> struct KeyTag<std::int32_t>  { static constexpr std::uint32_t value = 1; };
+template<> struct KeyTag<std::uint64_t> { static constexpr std::uint32_t value = 2; };
+template<> struct KeyTag<double>        { static constexpr std::uint32_t value = 3; };
+template<std::size_t N>
+struct KeyTag<FixedString<N>> { static constexpr std::uint32_t value = 0x100 | N; };
+
+inline std::uint64_t checksum(const void* data, std::size_t bytes)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < bytes; ++i) h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+template<class Key>
+void write(const std::string& path, Layout layout, std::span<const Key> keys)
+{
+    static_assert(std::is_trivially_copyable_v<Key>, "keys are stored bytewise");
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof kMagic);
+    h.version  = kVersion;
+    h.layout   = static_cast<std::uint32_t>(layout);
+    h.key_type = KeyTag<Key>::value;
+    h.key_size = sizeof(Key);
+    h.n        = keys.size();
+    h.checksum = checksum(keys.data(), keys.size_bytes());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&h), sizeof h);
+    out.write(reinterpret_cast<const char*>(keys.data()), keys.size_bytes());
+    if (!out) throw std::runtime_error("index_file: cannot write " + path);
+}
+
+// Read-only mapping of an index file; trees keep it alive via shared_ptr.
+class Mapping {
+    void*       base_ = MAP_FAILED;
+    std::size_t len_  = 0;
+
+public:
+    explicit Mapping(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) throw std::runtime_error("index_file: cannot open " + path);
+        struct stat st{};
+        if (fstat(fd, &st) == 0) len_ = static_cast<std::size_t>(st.st_size);
+        if (len_ >= sizeof(Header))
+            base_ = mmap(nullptr, len_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base_ == MAP_FAILED) throw std::runtime_error("index_file: cannot map " + path);
+    }
+    ~Mapping() { munmap(base_, len_); }
+
+    Mapping(const Mapping&)            = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    // Validates the header against the expected layout and key type and
+    // returns the key array; verify additionally recomputes the checksum,
+    // which reads (and faults in) the whole file.
+    template<class Key>
+    std::span<const Key> keys(Layout layout, bool verify) const
+    {
+        const auto& h = *static_cast<const Header*>(base_);
+        if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0)
+            throw std::runtime_error("index_file: bad magic");
+        if (h.version != kVersion)
+            throw std::runtime_error("index_file: unsupported version");
+        if (h.layout != static_cast<std::uint32_t>(layout))
+            throw std::runtime_error("index_file: layout mismatch");
+        if (h.key_type != KeyTag<Key>::value || h.key_size != sizeof(Key))
+            throw std::runtime_error("index_file: key type mismatch");
+        // divided, not multiplied: a corrupt n must not wrap around
+        if (h.n > (len_ - sizeof(Header)) / sizeof(Key))
+            throw std::runtime_error("index_file: truncated");
+
+        const Key* data = reinterpret_cast<const Key*>(static_cast<const char*>(base_) + sizeof(Header));
+        if (verify && checksum(data, h.n * sizeof(Key)) != h.checksum)
+            throw std::runtime_error("index_file: checksum mismatch");
+        return {data, static_cast<std::size_t>(h.n)};
+    }
+};
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Fixed-length string key stored inline, ordered bytewise like memcmp.
+template<std::size_t N>
+struct FixedString {
+    std::array<unsigned char, N> c{};
+
+    friend bool operator==(const FixedString&, const FixedString&) = default;
+    friend auto operator<=>(const FixedString&, const FixedString&) = default;
+};
+
+// Comparator/projection hook of the tree family. less/equal define the
+// order, project maps a key onto the real line (used to guess where it
+// lies between the min and max key) and max is the padding sentinel.
+// Specialize it to plug in a key type or a different ordering.
+template<class Key>
+struct KeyTraits {
+    static bool   less (const Key& a, const Key& b) { return a < b; }
+    static bool   equal(const Key& a, const Key& b) { return a == b; }
+    static double project(const Key& k)             { return static_cast<double>(k); }
+    static Key    max()
+    {
+        if constexpr (std::numeric_limits<Key>::has_infinity)
+            return std::numeric_limits<Key>::infinity();
+        return std::numeric_limits<Key>::max();
+    }
+};
+
+template<std::size_t N>
+struct KeyTraits<FixedString<N>> {
+    using Key = FixedString<N>;
+
+    static bool less (const Key& a, const Key& b) { return std::memcmp(a.c.data(), b.c.data(), N) <  0; }
+    static bool equal(const Key& a, const Key& b) { return std::memcmp(a.c.data(), b.c.data(), N) == 0; }
+
+    // the first eight bytes read as a big-endian integer
+    static double project(const Key& k)
+    {
+        std::uint64_t v = 0;
+        for (std::size_t i = 0; i < 8; ++i) v = (v << 8) | (i < N ? k.c[i] : 0);
+        return static_cast<double>(v);
+    }
+    static Key max()
+    {
+        Key k;
+        k.c.fill(0xFF);
+        return k;
+    }
+};
+
+// KeyTraits as function objects, so std::sort and friends inline them.
+template<class Key>
+struct KeyLess {
+    bool operator()(const Key& a, const Key& b) const { return KeyTraits<Key>::less(a, b); }
+};
+template<class Key>
+struct KeyEqual {
+    bool operator()(const Key& a, const Key& b) const { return KeyTraits<Key>::equal(a, b); }
+};
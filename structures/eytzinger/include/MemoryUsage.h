@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <string>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Resident memory of this process, for the peak memory of a build.
+namespace help {
+
+// A "VmRSS:"-style field of /proc/self/status in bytes, 0 if missing.
+inline std::size_t statusBytes(const std::string& field)
+{
+    std::ifstream in("/proc/self/status");
+    for (std::string line; std::getline(in, line); )
+        if (line.compare(0, field.size(), field) == 0)
+            return std::stoull(line.substr(field.size())) * 1024;   // reported in kB
+    return 0;
+}
+
+inline std::size_t residentBytes() { return statusBytes("VmRSS:"); }
+
+// High-water mark of the resident memory since the last resetPeakResident.
+inline std::size_t peakResidentBytes() { return statusBytes("VmHWM:"); }
+
+// Lowers the high-water mark to the current resident memory (Linux 4.0+);
+// false if the kernel refused. Free heap memory is handed back first, so
+// what earlier runs freed does not hide what the next one allocates.
+inline bool resetPeakResident()
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    std::ofstream f("/proc/self/clear_refs");
+    f << "5";
+    f.flush();
+    return bool(f);
+}
+
+}
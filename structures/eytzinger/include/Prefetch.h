@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+namespace help {
+
+// Prefetches every cache line of the Count keys from p on. An unaligned
+// run of Count keys can touch one line more than its size fills, so this
+// is a fixed number of prefetches (one per 64 bytes from p, plus one at
+// the last key) and takes no branch on the alignment.
+template<std::size_t Count, class Key>
+inline void prefetchSpan(const Key* p)
+{
+    constexpr std::size_t bytes = Count * sizeof(Key);
+    const char* c = reinterpret_cast<const char*>(p);
+    for (std::size_t off = 0; off < bytes; off += 64) __builtin_prefetch(c + off, 0, 1);
+    __builtin_prefetch(c + bytes - 1, 0, 1);
+}
+
+}
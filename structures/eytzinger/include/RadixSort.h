@@ -0,0 +1,201 @@
+#pragma once
+#include "Parallel.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// The sort + dedup every tree runs on its collected keys before laying
+// them out. Integral keys go through a parallel LSD radix sort, one byte
+// per pass, or, when inPlace asks not to allocate its n-key scatter
+// buffer, through an in-place MSD radix sort (American flag sort);
+// everything else through std::sort. Input that is already sorted is
+// detected in the first read and not sorted again.
+namespace help {
+
+namespace radix {
+
+constexpr std::size_t kMinSize = std::size_t(1) << 12;   // std::sort below
+
+// Order-preserving unsigned image of an integral key.
+template<class Key>
+auto bits(Key k)
+{
+    using U = std::make_unsigned_t<Key>;
+    U u = static_cast<U>(k);
+    if constexpr (std::is_signed_v<Key>) u ^= U(1) << (8 * sizeof(Key) - 1);
+    return u;
+}
+
+template<class Key>
+unsigned digit(Key k, unsigned pass) { return (bits(k) >> (8 * pass)) & 0xff; }
+
+using Counts = std::array<std::size_t, 256>;
+
+// Sorts v (at least kMinSize keys), ending in v or in buf; returns the
+// one holding the result. The first read counts the digits of every pass and checks the order;
+// passes on which all keys share a digit are skipped, the others count
+// their digits per chunk and scatter each chunk to its own offsets, which
+// keeps the passes stable.
+template<class Key>
+std::vector<Key>& sort(std::vector<Key>& v, std::vector<Key>& buf)
+{
+    constexpr unsigned kPasses = sizeof(Key);
+    const std::size_t  n       = v.size();
+    const std::size_t  T       = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                                       (n + kMinSize - 1) / kMinSize);
+    const std::size_t  chunk   = (n + T - 1) / T;
+
+    std::vector<std::array<Counts, kPasses>> count(T);
+    std::vector<char> inOrder(T, 1);
+    help::parallel_for(T, [&](std::size_t tb, std::size_t te) {
+        for (std::size_t t = tb; t < te; ++t) {
+            const std::size_t b = t * chunk, e = std::min(n, b + chunk);
+            auto& c = count[t];
+            for (auto& p : c) p.fill(0);
+            for (std::size_t i = b; i < e; ++i) {
+                for (unsigned p = 0; p < kPasses; ++p) ++c[p][digit(v[i], p)];
+                if (i > b && v[i] < v[i - 1]) inOrder[t] = 0;
+            }
+            if (b > 0 && b < e && v[b] < v[b - 1]) inOrder[t] = 0;
+        }
+    }, 1);
+
+    if (std::all_of(inOrder.begin(), inOrder.end(), [](char c) { return c; })) return v;
+
+    buf.resize(n);
+    Key* src = v.data();
+    Key* dst = buf.data();
+    bool fresh = true;   // count[] still describes src
+    for (unsigned p = 0; p < kPasses; ++p) {
+        // the digit totals do not depend on the order, so the first
+        // read's tell whether all keys share this byte
+        bool trivial = false;
+        for (unsigned d = 0; d < 256 && !trivial; ++d) {
+            std::size_t s = 0;
+            for (std::size_t t = 0; t < T; ++t) s += count[t][p][d];
+            trivial = s == n;
+        }
+        if (trivial) continue;
+
+        if (!fresh) {
+            help::parallel_for(T, [&](std::size_t tb, std::size_t te) {
+                for (std::size_t t = tb; t < te; ++t) {
+                    auto& c = count[t][p];
+                    c.fill(0);
+                    for (std::size_t i = t * chunk, e = std::min(n, i + chunk); i < e; ++i) ++c[digit(src[i], p)];
+                }
+            }, 1);
+        }
+
+        // offset of digit d for chunk t: all smaller digits, then the
+        // earlier chunks' keys with digit d
+        std::size_t off = 0;
+        for (unsigned d = 0; d < 256; ++d)
+            for (std::size_t t = 0; t < T; ++t) {
+                std::size_t c = count[t][p][d];
+                count[t][p][d] = off;
+                off += c;
+            }
+
+        help::parallel_for(T, [&](std::size_t tb, std::size_t te) {
+            for (std::size_t t = tb; t < te; ++t) {
+                auto& o = count[t][p];
+                for (std::size_t i = t * chunk, e = std::min(n, i + chunk); i < e; ++i)
+                    dst[o[digit(src[i], p)]++] = src[i];
+            }
+        }, 1);
+        std::swap(src, dst);
+        fresh = false;
+    }
+    return src == v.data() ? v : buf;
+}
+
+// Swaps a[0, n) into the buckets of byte pass, given their sizes, along
+// the cycles of the permutation (American flag sort). Returns where each
+// bucket starts.
+template<class Key>
+Counts flagPass(Key* a, const Counts& size, int pass)
+{
+    Counts start{}, head{};
+    for (std::size_t d = 0, off = 0; d < 256; off += size[d++]) start[d] = head[d] = off;
+    for (unsigned d = 0; d < 256; ++d) {
+        const std::size_t end = start[d] + size[d];
+        while (head[d] < end) {
+            Key x = a[head[d]];
+            for (unsigned b = digit(x, pass); b != d; b = digit(x, pass)) std::swap(x, a[head[b]++]);
+            a[head[d]++] = x;
+        }
+    }
+    return start;
+}
+
+// In-place MSD radix sort of a[0, n) from byte pass down; bytes all keys
+// share are skipped, small ranges go to std::sort. The buckets of the
+// first split are sorted in parallel.
+template<class Key>
+void flagSort(Key* a, std::size_t n, int pass, bool parallel = false)
+{
+    Counts size{};
+    for (; pass >= 0 && n >= 64; --pass) {
+        size.fill(0);
+        for (std::size_t i = 0; i < n; ++i) ++size[digit(a[i], pass)];
+        if (std::find(size.begin(), size.end(), n) == size.end()) break;
+    }
+    if (pass < 0 || n < 64) {
+        std::sort(a, a + n);
+        return;
+    }
+    const Counts start = flagPass(a, size, pass);
+    auto sub = [&](std::size_t b, std::size_t e) {
+        for (std::size_t d = b; d < e; ++d) flagSort(a + start[d], size[d], pass - 1);
+    };
+    if (parallel) help::parallel_for(256, sub, 1);
+    else          sub(0, 256);
+}
+
+}
+
+// Sorts v by less. Integral keys must use their natural order with it.
+template<class Key, class Less = std::less<Key>>
+void sortKeys(std::vector<Key>& v, Less less = {}, bool inPlace = false)
+{
+    if constexpr (std::is_integral_v<Key>) {
+        if (v.size() >= radix::kMinSize) {
+            if (inPlace) {
+                if (!std::is_sorted(v.begin(), v.end())) radix::flagSort(v.data(), v.size(), sizeof(Key) - 1, true);
+            } else {
+                std::vector<Key> buf;
+                if (&radix::sort(v, buf) != &v) v.swap(buf);
+            }
+            return;
+        }
+    }
+    if (!std::is_sorted(v.begin(), v.end(), less)) std::sort(v.begin(), v.end(), less);
+}
+
+// sortKeys, then one copy of every key. For integral keys the dedup is
+// fused with the copy back from the scatter buffer when the passes end
+// there.
+template<class Key, class Less = std::less<Key>, class Equal = std::equal_to<Key>>
+void sortUnique(std::vector<Key>& v, Less less = {}, Equal equal = {}, bool inPlace = false)
+{
+    if constexpr (std::is_integral_v<Key>) {
+        if (!inPlace && v.size() >= radix::kMinSize) {
+            std::vector<Key> buf;
+            if (&radix::sort(v, buf) != &v) {
+                v.resize(std::unique_copy(buf.begin(), buf.end(), v.begin(), equal) - v.begin());
+                return;
+            }
+            v.erase(std::unique(v.begin(), v.end(), equal), v.end());
+            return;
+        }
+    }
+    sortKeys(v, less, inPlace);
+    v.erase(std::unique(v.begin(), v.end(), equal), v.end());
+}
+
+}
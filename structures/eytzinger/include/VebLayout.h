@@ -0,0 +1,155 @@
+#pragma once
+#include "Parallel.h"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Height-split (van Emde Boas) layout of a binary search tree, navigated
+// without pointers through per-depth tables (Brodal, Fagerberg and Jacob,
+// 2002). A tree of height h is cut below its top h/2 levels; the top
+// subtree is laid out first, then the 2^(h/2) bottom subtrees left to
+// right, each recursively the same way. Since every subtree of a given
+// height is cut at the same depth, a node at depth d is always the root of
+// a bottom subtree of size B[d] hanging below a top subtree of size T[d]
+// whose root is at depth D[d]. With Pos[] the positions of the nodes on the
+// search path, the node with 1-based BFS index i at depth d is at
+//
+//     Pos[d] = Pos[D[d]] + T[d] + (i & T[d]) * B[d]
+//
+// (T[d] = 2^(d - D[d]) - 1 doubles as the mask of i below that top root).
+// n keys that do not fill a perfect tree take the first n positions of the
+// perfect tree of height bit_width(n). Parents precede their children in
+// that order, so those nodes form a tree, and a child exists iff its
+// position is below n.
+namespace help {
+
+struct VebTables {
+    // The cut above depth d: the nodes at d are roots of bottom subtrees of
+    // botSize keys below a top subtree of topSize keys rooted at depth top.
+    struct Level {
+        std::size_t topSize = 0;   // T[d], also the mask of i below that root
+        std::size_t botSize = 0;   // B[d]
+        unsigned    top     = 0;   // D[d]
+    };
+
+    unsigned              height = 0;
+    std::array<Level, 64> level{};
+
+    VebTables() = default;
+    explicit VebTables(unsigned h) : height(h) { split(0, h); }
+
+    // Position of the node with BFS index i at depth d > 0, given those of
+    // its ancestors in path[0, d).
+    std::size_t pos(const std::size_t* path, unsigned d, std::size_t i) const {
+        const Level& l = level[d];
+        return path[l.top] + l.topSize + (i & l.topSize) * l.botSize;
+    }
+
+    // Depths whose nodes can lie more than a cache line from their parent:
+    // those where the subtree the cut splits spans more than 64 bytes.
+    std::uint64_t farLevels(std::size_t keyBytes) const {
+        std::uint64_t m = 0;
+        for (unsigned d = 1; d < height; ++d)
+            if ((level[d].topSize + 1) * (level[d].botSize + 1) * keyBytes > 64) m |= std::uint64_t(1) << d;
+        return m;
+    }
+
+    // Prefetches the (up to four) grandchildren of the node with BFS index
+    // i at depth d, path[0, d] holding its position and its ancestors'.
+    template<class Key>
+    void prefetchGrandchildren(const Key* a, std::size_t n, const std::size_t* path,
+                               unsigned d, std::size_t i) const
+    {
+        const std::size_t child[2] = {pos(path, d + 1, 2*i), pos(path, d + 1, 2*i + 1)};
+        const Level& l = level[d + 2];
+        for (std::size_t g = 0; g < 4; ++g) {
+            const std::size_t base = l.top == d + 1 ? child[g >> 1] : path[l.top];
+            const std::size_t p    = base + l.topSize + ((4*i + g) & l.topSize) * l.botSize;
+            if (p < n) __builtin_prefetch(a + p, 0, 1);
+        }
+    }
+
+private:
+    void split(unsigned root, unsigned h) {
+        if (h < 2) return;
+        const unsigned ht = h / 2, hb = h - ht, d = root + ht;
+        level[d] = {(std::size_t(1) << ht) - 1, (std::size_t(1) << hb) - 1, root};
+        split(root, ht);
+        split(d, hb);
+    }
+};
+
+// Calls visit(position) for the nodes of the subtree rooted at BFS index i,
+// depth d and position p, in key order, stopping above depth limit. The
+// subtree must not need ancestors above d to place its nodes: the whole
+// tree, or a bottom subtree of the topmost cut.
+template<class Visit>
+void vebInorder(const VebTables& t, std::size_t n, std::size_t i, unsigned d,
+                std::size_t p, unsigned limit, Visit visit)
+{
+    struct Frame { std::size_t i, p; unsigned d; };
+    Frame       st[64];
+    std::size_t path[64];
+    std::size_t top = 0;
+
+    auto leftmost = [&](std::size_t i, unsigned d, std::size_t p) {
+        for (;;) {
+            path[d]   = p;
+            st[top++] = {i, p, d};
+            if (d + 1 >= limit) return;
+            const std::size_t c = t.pos(path, d + 1, 2*i);
+            if (c >= n) return;
+            i = 2*i; p = c; ++d;
+        }
+    };
+
+    if (p >= n) return;
+    leftmost(i, d, p);
+    while (top) {
+        const Frame f = st[--top];
+        visit(f.p);
+        if (f.d + 1 >= limit) continue;
+        const std::size_t c = t.pos(path, f.d + 1, 2*f.i + 1);
+        if (c < n) leftmost(2*f.i + 1, f.d + 1, c);
+    }
+}
+
+// Gathers sorted into out in the layout. The topmost cut splits the keys
+// into the top subtree and bottom subtrees whose key ranges are known: the
+// bottom subtrees fill up left to right, so all before the last one are
+// full. The bottom subtrees are filled in parallel, then the top.
+template<class Key, class Alloc>
+void build_veb(std::vector<Key, Alloc>& out, const std::vector<Key>& sorted, const VebTables& t)
+{
+    const std::size_t n = sorted.size();
+    out.resize(n);
+    if (n <= (std::size_t(1) << 16)) {
+        std::size_t r = 0;
+        vebInorder(t, n, 1, 0, 0, t.height, [&](std::size_t p) { out[p] = sorted[r++]; });
+        return;
+    }
+
+    const unsigned    ht   = t.height / 2;
+    const std::size_t T    = t.level[ht].topSize, B = t.level[ht].botSize;
+    const std::size_t full = (n - T) / B, rest = (n - T) % B;
+    const std::size_t subtrees = full + (rest != 0);
+
+    parallel_for(subtrees, [&](std::size_t b, std::size_t e) {
+        for (std::size_t j = b; j < e; ++j) {
+            std::size_t r = j * (B + 1);
+            vebInorder(t, n, (std::size_t(1) << ht) + j, ht, T + j * B, t.height,
+                       [&](std::size_t p) { out[p] = sorted[r++]; });
+        }
+    }, 1);
+
+    // the j-th top node in key order follows bottom subtrees 0..j
+    std::size_t j = 0;
+    vebInorder(t, n, 1, 0, 0, ht, [&](std::size_t p) {
+        const std::size_t below = j < full ? (j + 1) * B : full * B + rest;
+        out[p] = sorted[below + j++];
+    });
+}
+
+}
@@ -2,8 +2,9 @@
 
 make
 
-IMPLS=("BST_VEB" "BST_EYT" "BST_EYT_PREF" "BST_EYT_PREF_TWO" "BST_EYT_PREF_THREE" "BST_EYT_PREF_FOUR" "BST_EYT_PREF_PROB")    
+IMPLS=("BST_VEB" "BST_PRE" "BST_EYT" "BST_EYT_PREF" "BST_EYT_PREF_TWO" "BST_EYT_PREF_THREE" "BST_EYT_PREF_FOUR" "BST_EYT_PREF_PROB" "BST_EYT_BRANCHLESS" "BST_EYT_ADAPTIVE" "BST_EYT_ALIGNED" "BST_STREE" "BST_PGM")    
 
+# every run prints the header; keep the first one
 for impl in "${IMPLS[@]}"; do
   ./bst-bench "$1" "$impl"
-done
+done | awk '!(/^(impl|---)/ && seen[$0]++)'
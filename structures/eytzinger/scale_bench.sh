@@ -32,7 +32,7 @@ $LINK_Q && echo "# q linked to n"
 make
 
 IMPLS=(
-  "BST_VEB" "BST_EYT" "BST_EYT_PREF" "BST_EYT_PREF_TWO" "BST_EYT_PREF_THREE" "BST_EYT_PREF_FOUR" "BST_EYT_PREF_PROB"
+  "BST_VEB" "BST_PRE" "BST_EYT" "BST_EYT_PREF" "BST_EYT_PREF_TWO" "BST_EYT_PREF_THREE" "BST_EYT_PREF_FOUR" "BST_EYT_PREF_PROB" "BST_EYT_BRANCHLESS" "BST_EYT_ADAPTIVE" "BST_EYT_ALIGNED" "BST_STREE" "BST_PGM"
 )
 
 TMP=$(mktemp)
@@ -1,24 +1,75 @@
 #include "IBST.h"
 #include "BSTVEB.h"
+#include "BSTPreorder.h"
 #include "BSTEyt.h"
 #include "BSTEytPrefetch.h"
 #include "BSTEytPrefetchTwo.h"
 #include "BSTEytPrefetchThree.h"
 #include "BSTEytPrefetchFour.h"
 #include "BSTEytPrefetchProb.h"
+#include "BSTEytBranchless.h"
+#include "BSTSTree.h"
+#include "BSTEytCompressed.h"
+#include "BSTEytAdaptive.h"
+#include "BSTEytAligned.h"
+#include "BSTPgm.h"
+#include "KeyTraits.h"
+#include "HugePageAllocator.h"
+#include "Builder.h"
+#include "BSTLsm.h"
 #include "PerfCounters.h"
+#include "LatencyHistogram.h"
+#include "Workload.h"
+#include "MemoryUsage.h"
 #include <vector>
 #include <random>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
-#include <functional>
+#include <tuple>
+#include <array>
 #include <chrono>
+#include <memory>
+#include <algorithm>
+#include <span>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <cmath>
 #include "util/json.hpp"
 
 using json  = nlohmann::json;
 using Clock = std::chrono::steady_clock;
 
+// What every lookup key is used for; everything but contains and
+// lower_bound needs the ordered queries of the Eytzinger trees.
+enum class Query { Contains, LowerBound, UpperBound, Rank, CountRange, Scan };
+
+struct Config {
+    int         n = 10000, q = 10000, T = 1;
+    bool        csv = false;
+    unsigned    seed = 42;
+    std::string impl = "ALL";
+    bool        measure_construction = true;
+    std::size_t batch = 0;
+    std::string key_type = "int";
+    unsigned    threads = 0;     // > 0: sweep 1..threads readers on one tree
+    bool        huge_pages = false;
+    std::string index_dir;       // non-empty: build once, save, query the mapped file
+    std::string query = "contains";
+    Query       query_kind = Query::Contains;
+    std::size_t scan_len = 16;   // keys visited per scan query
+    bool        multiset = false;
+    double      write_frac = 0;  // > 0: mixed read/write mode on the dynamic sets
+    double      delete_frac = 0.5;
+    std::size_t latency_sample = 0;  // > 0: also time every k-th lookup on its own
+    workload::Spec workload;         // lookup distribution, hit ratio, order, trace
+    bool        calibrate_prefetch = false;  // BST_EYT_ADAPTIVE times its candidate depths
+    bool        in_place = false;            // permute the sorted keys into the layout in place
+};
+
 struct Metrics {
     long long ns = 0, ops = 0;
 
@@ -28,73 +79,388 @@ struct Metrics {
     long long l3_refs = 0, l3_miss = 0;
 
     long long branches = 0, br_miss = 0;
+    long long dtlb_miss = 0;
+    long long cycles = 0, instr = 0, stalls = 0;
+
+    long long sort_ns = 0, layout_ns = 0;
+    long long peak_bytes = 0;   // resident memory the build added at its peak
 };
 
-template<class Key>
-Metrics benchOnce(IBST<Key>& tree,
+void readCounters(Metrics& m, const PerfCounters& pc)
+{
+    m.c_refs   = pc.refs();       m.c_miss   = pc.misses();
+    m.l1_refs  = pc.l1_refs();    m.l1_miss  = pc.l1_misses();
+    m.l2_refs  = pc.l2_refs();    m.l2_miss  = pc.l2_misses();
+    m.l3_refs  = pc.l3_refs();    m.l3_miss  = pc.l3_misses();
+    m.branches = pc.branches();   m.br_miss  = pc.branch_misses();
+    m.dtlb_miss = pc.dtlb_misses();
+    m.cycles   = pc.cycles();     m.instr    = pc.instructions();
+    m.stalls   = pc.stalled_cycles();
+}
+
+// Keeps a result alive once the lookups are inlined into the timed loop.
+template<class T>
+inline void keep(const T& v) { asm volatile("" : : "g"(v) : "memory"); }
+
+// Trees with rank, count_range and range iteration.
+template<class Tree>
+concept Ordered = requires(const Tree& t, const typename Tree::key_type& k) {
+    t.upper_bound(k);
+    t.rank(k);
+    t.count_range(k, k);
+    t.seek(k);
+};
+
+template<class Tree>
+constexpr bool supports(const Config& cfg)
+{
+    using Key = typename Tree::key_type;
+    if (cfg.multiset && !std::is_constructible_v<Tree, std::vector<Key>, KeyMode>) return false;
+    switch (cfg.query_kind) {
+    case Query::Contains:
+    case Query::LowerBound: return true;
+    default:                return Ordered<Tree>;
+    }
+}
+
+// Trees that pick their prefetch depth at build time.
+template<class Tree>
+concept Adaptive = requires(const Tree& t) { t.prefetch_plan(); };
+
+// "d<depth>/s<skip>" of an adaptive tree, '*' if calibrated; "-" otherwise.
+template<class Tree>
+std::string prefetchLabel(const Tree& t)
+{
+    if constexpr (Adaptive<Tree>) {
+        const auto& p = t.prefetch_plan();
+        return "d" + std::to_string(p.depth) + "/s" + std::to_string(p.skip) + (p.calibrated ? "*" : "");
+    } else {
+        (void)t;
+        return "-";
+    }
+}
+
+// Calls make with the constructor options of Tree the config selects.
+template<class Tree, class Key, class Make>
+auto withOptions(const Config& cfg, Make make)
+{
+    const KeyMode mode   = cfg.multiset ? KeyMode::Multiset : KeyMode::Set;
+    const Freeze  freeze = cfg.in_place ? Freeze::InPlace : Freeze::Gather;
+    if constexpr (Adaptive<Tree>)
+        return make(mode, cfg.calibrate_prefetch, freeze);
+    else if constexpr (std::is_constructible_v<Tree, std::vector<Key>, KeyMode, Freeze>)
+        return make(mode, freeze);
+    else if constexpr (std::is_constructible_v<Tree, std::vector<Key>, Freeze>)
+        return make(freeze);
+    else if constexpr (std::is_constructible_v<Tree, std::vector<Key>, KeyMode>)
+        return make(mode);
+    else
+        return make();
+}
+
+template<class Tree, class Key>
+Tree buildTree(const Config& cfg, std::vector<Key> keys)
+{
+    return withOptions<Tree, Key>(cfg, [&](auto... opts) { return Tree(std::move(keys), opts...); });
+}
+
+// Answers every key with the configured query and folds the answers into
+// one value. Count and scan queries pair each key with its successor in
+// the lookup list, or visit scan_len keys starting at it.
+template<class Tree, class Key>
+std::size_t runQueries(const Tree& t, std::span<const Key> keys, const Config& cfg)
+{
+    using Tr = KeyTraits<Key>;
+    std::size_t acc = 0;
+    switch (cfg.query_kind) {
+    case Query::Contains:
+        for (const auto& k : keys) acc += t.Tree::contains(k);
+        break;
+    case Query::LowerBound:
+        for (const auto& k : keys) acc += t.Tree::lower_bound(k).has_value();
+        break;
+    default:
+        if constexpr (Ordered<Tree>) {
+            switch (cfg.query_kind) {
+            case Query::UpperBound:
+                for (const auto& k : keys) acc += t.Tree::upper_bound(k).has_value();
+                break;
+            case Query::Rank:
+                for (const auto& k : keys) acc += t.Tree::rank(k);
+                break;
+            case Query::CountRange:
+                for (std::size_t i = 0; i < keys.size(); ++i) {
+                    const Key& a = keys[i];
+                    const Key& b = keys[i + 1 < keys.size() ? i + 1 : 0];
+                    acc += Tr::less(b, a) ? t.Tree::count_range(b, a) : t.Tree::count_range(a, b);
+                }
+                break;
+            case Query::Scan:
+                for (const auto& k : keys) {
+                    auto it = t.Tree::seek(k), end = t.end();
+                    for (std::size_t j = 0; j < cfg.scan_len && it != end; ++j, ++it)
+                        acc += !Tr::less(*it, k);
+                }
+                break;
+            default: break;
+            }
+        }
+    }
+    return acc;
+}
+
+// One query of the configured kind; next is the key count_range pairs it
+// with. The per-lookup latency pass times these one at a time.
+template<class Tree, class Key>
+std::size_t queryOne(const Tree& t, const Key& k, const Key& next, const Config& cfg)
+{
+    using Tr = KeyTraits<Key>;
+    switch (cfg.query_kind) {
+    case Query::Contains:   return t.Tree::contains(k);
+    case Query::LowerBound: return t.Tree::lower_bound(k).has_value();
+    default:
+        if constexpr (Ordered<Tree>) {
+            switch (cfg.query_kind) {
+            case Query::UpperBound: return t.Tree::upper_bound(k).has_value();
+            case Query::Rank:       return t.Tree::rank(k);
+            case Query::CountRange:
+                return Tr::less(next, k) ? t.Tree::count_range(next, k) : t.Tree::count_range(k, next);
+            case Query::Scan: {
+                std::size_t acc = 0;
+                auto it = t.Tree::seek(k), end = t.end();
+                for (std::size_t j = 0; j < cfg.scan_len && it != end; ++j, ++it)
+                    acc += !Tr::less(*it, k);
+                return acc;
+            }
+            default: break;
+            }
+        }
+    }
+    return 0;
+}
+
+// Times every latency_sample-th lookup individually into hist (in TSC
+// ticks, timer overhead subtracted). Runs after the throughput loop so
+// the timestamps do not disturb it.
+template<class Tree, class Key>
+void sampleLatency(const Tree& t, const std::vector<Key>& lookups,
+                   const Config& cfg, latency::Histogram& hist)
+{
+    for (std::size_t i = 0; i < lookups.size(); i += cfg.latency_sample) {
+        const Key& next = lookups[i + 1 < lookups.size() ? i + 1 : 0];
+        std::size_t r = 0;
+        hist.record(latency::measure([&] { r = queryOne(t, lookups[i], next, cfg); keep(r); }));
+    }
+}
+
+// The harness is instantiated per concrete tree type and every call into
+// the tree is qualified, so the timed loops dispatch statically and the
+// descent kernels can be inlined into them. Unless a tree is passed in
+// (an opened index file) it is built from inserts, inside the timed
+// region when measure_construction is set. batch only applies to contains.
+// With a histogram the sampled per-lookup latencies are added to it.
+template<class Tree, class Key>
+Metrics benchOnce(std::unique_ptr<Tree>& tree,
                   const std::vector<Key>& lookups,
                   const std::vector<Key>& inserts,
-                  bool       measure_construction)
+                  const Config& cfg,
+                  latency::Histogram* lat = nullptr)
 {
-    for (const auto& k : inserts) tree.insert(k);
+    const std::size_t batch = cfg.query_kind == Query::Contains ? cfg.batch : 0;
+    // peak of the collected keys plus whatever the build adds to them
+    const bool        tracked = !tree && help::resetPeakResident();
+    const std::size_t rss0    = tracked ? help::residentBytes() : 0;
+    Builder<Tree> builder(inserts.size());
+    for (const auto& k : inserts) builder.insert(k);
 
-    if (!measure_construction && !lookups.empty()) (void)tree.contains(lookups[0]);
+    auto build = [&] {
+        return withOptions<Tree, Key>(cfg, [&](auto... opts) {
+            return std::make_unique<Tree>(builder.build(opts...));
+        });
+    };
+    if (!tree && !cfg.measure_construction) tree = build();
 
+    std::unique_ptr<bool[]> hits;
+    if (batch) hits.reset(new bool[lookups.size()]);
+
+    std::size_t found = 0;
     PerfCounters pc; pc.start();
     auto t0 = Clock::now();
-    for (const auto& k : lookups) (void)tree.contains(k);
+    if (!tree) tree = build();
+    if (batch) {
+        tree->set_group(batch);
+        tree->Tree::contains_batch(std::span<const Key>(lookups),
+                                   std::span<bool>(hits.get(), lookups.size()));
+    } else {
+        found = runQueries(*tree, std::span<const Key>(lookups), cfg);
+    }
     auto t1 = Clock::now();
     pc.stop();
+    const std::size_t peak = tracked ? help::peakResidentBytes() : 0;
+    if (batch) found = std::count(hits.get(), hits.get() + lookups.size(), true);
+    keep(found);
 
     Metrics m;
     m.ns       = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
     m.ops      = lookups.size();
 
-    m.c_refs   = pc.refs();       m.c_miss   = pc.misses();
-    m.l1_refs  = pc.l1_refs();    m.l1_miss  = pc.l1_misses();
-    m.l2_refs  = pc.l2_refs();    m.l2_miss  = pc.l2_misses();
-    m.l3_refs  = pc.l3_refs();    m.l3_miss  = pc.l3_misses();
-    m.branches = pc.branches();   m.br_miss  = pc.branch_misses();
+    readCounters(m, pc);
+    if (lat) sampleLatency(*tree, lookups, cfg, *lat);
+
+    m.peak_bytes = peak > rss0 ? peak - rss0 : 0;
+    m.sort_ns   = tree->build_stats().sort_ns;
+    m.layout_ns = tree->build_stats().layout_ns;
     return m;
 }
 
-using Factory = std::function<std::unique_ptr<IBST<int>>()>;
-struct Variant { std::string name; Factory make; };
+// Registry entry: the tree type is the template argument, the name is what
+// the config's impl selects and the output prints.
+template<class Tree>
+struct Impl { const char* name; };
 
-const std::vector<Variant> variants = {
-    {"BST_VEB",      [] { return std::make_unique<BSTVEB<int>>(); }},
-    {"BST_EYT",      [] { return std::make_unique<BSTEyt<int>>(); }},
-    {"BST_EYT_PREF", [] { return std::make_unique<BSTEytPref<int>>(); }},
-    {"BST_EYT_PREF_TWO", [] { return std::make_unique<BSTEytPrefTwo<int>>(); }},
-    {"BST_EYT_PREF_THREE", [] { return std::make_unique<BSTEytPrefThree<int>>(); }},
-    {"BST_EYT_PREF_FOUR", [] { return std::make_unique<BSTEytPrefFour<int>>(); }},
-    {"BST_EYT_PREF_PROB", [] { return std::make_unique<BSTEytPrefProb<int>>(); }},
+// Trees with an on-disk format (see IndexFile.h).
+template<class Tree>
+concept Persistent = requires(const Tree& t, const std::string& path) {
+    t.save(path);
+    Tree::template open<Tree>(path);
 };
 
-void runExperiment(int n, int q, int T, bool csv,
-                   const Factory& make, unsigned seed,
-                   const std::string& impl, bool measure_construction)
+// Huge selects huge-page backed storage for the frozen arrays.
+template<class Key, bool Huge>
+auto registry()
+{
+    using A  = std::conditional_t<Huge, HugePageAllocator<Key>, std::allocator<Key>>;
+    using AA = std::conditional_t<Huge, HugePageAllocator<Key>, AlignedAllocator<Key>>;
+    auto base = std::tuple{
+        Impl<BSTVEB<Key, A>>{"BST_VEB"},
+        Impl<BSTPreorder<Key, A>>{"BST_PRE"},
+        Impl<BSTEyt<Key, A>>{"BST_EYT"},
+        Impl<BSTEytPref<Key, A>>{"BST_EYT_PREF"},
+        Impl<BSTEytPrefTwo<Key, A>>{"BST_EYT_PREF_TWO"},
+        Impl<BSTEytPrefThree<Key, A>>{"BST_EYT_PREF_THREE"},
+        Impl<BSTEytPrefFour<Key, A>>{"BST_EYT_PREF_FOUR"},
+        Impl<BSTEytPrefProb<Key, 8, A>>{"BST_EYT_PREF_PROB"},
+        Impl<BSTEytBranchless<Key, A>>{"BST_EYT_BRANCHLESS"},
+        Impl<BSTEytAdaptive<Key, A>>{"BST_EYT_ADAPTIVE"},
+        Impl<BSTEytAligned<Key, AA>>{"BST_EYT_ALIGNED"},
+        Impl<BSTSTree<Key, AA>>{"BST_STREE"},
+    };
+    // the learned model needs arithmetic keys, frame-of-reference blocks
+    // 32-bit integers
+    if constexpr (std::is_same_v<Key, int>)
+        return std::tuple_cat(base, std::tuple{Impl<BSTPgm<Key, A>>{"BST_PGM"},
+                                               Impl<BSTEytCompressed<Key, AA>>{"BST_EYT_COMPRESSED"}});
+    else if constexpr (std::is_arithmetic_v<Key>)
+        return std::tuple_cat(base, std::tuple{Impl<BSTPgm<Key, A>>{"BST_PGM"}});
+    else
+        return base;
+}
+
+// Structures that accept writes after they were built (mixed mode).
+template<class Key, bool Huge>
+auto dynamicRegistry()
+{
+    using A = std::conditional_t<Huge, HugePageAllocator<Key>, std::allocator<Key>>;
+    return std::tuple{
+        Impl<BSTLsm<Key, A>>{"BST_LSM"},
+    };
+}
+
+// Maps the uniform draw v in [1, 10n] injectively onto Key, so every key
+// type sees the same set sizes and hit ratio.
+template<class Key>
+Key makeKey(std::uint64_t v)
+{
+    if constexpr (std::is_same_v<Key, std::uint64_t>) {
+        return v * 0x9E3779B97F4A7C15ULL;
+    } else if constexpr (std::is_floating_point_v<Key>) {
+        return static_cast<Key>(v) + Key(0.5);
+    } else if constexpr (std::is_integral_v<Key>) {
+        return static_cast<Key>(v);
+    } else {
+        static const char hex[] = "0123456789abcdef";
+        std::uint64_t h = v * 0x9E3779B97F4A7C15ULL;
+        Key k;
+        for (std::size_t i = 0; i < k.c.size(); ++i)
+            k.c[i] = hex[(h >> (60 - 4 * (i % 16))) & 15];
+        return k;
+    }
+}
+
+// A trace line as Key; strings are cut or zero-padded to the key length.
+template<class Key>
+Key parseKey(const std::string& s)
+{
+    if constexpr (std::is_arithmetic_v<Key>) {
+        if constexpr (std::is_floating_point_v<Key>) return static_cast<Key>(std::stod(s));
+        else if constexpr (std::is_signed_v<Key>)    return static_cast<Key>(std::stoll(s));
+        else                                         return static_cast<Key>(std::stoull(s));
+    } else {
+        Key k;
+        std::copy_n(s.begin(), std::min(s.size(), k.c.size()), k.c.begin());
+        return k;
+    }
+}
+
+// Generated once per key type, so every implementation sees the same stream.
+template<class Key>
+workload::Stream<Key> makeWorkload(const Config& cfg)
 {
-    std::mt19937 rng(seed);
-    std::uniform_int_distribution<int> dist(1, n * 10);
+    return workload::generate<Key>(cfg.workload, cfg.n, cfg.q, cfg.seed,
+                                   makeKey<Key>, parseKey<Key>, KeyLess<Key>{});
+}
+
+// With an index_dir the tree is built and saved once; every trial then
+// opens the file (timed as open_ns) and queries the mapping, so the
+// lookups include the page faults of a cold mapping but never a rebuild.
+template<class Tree, class Key>
+void runExperiment(const Config& cfg, const std::string& impl, const workload::Stream<Key>& w)
+{
+    const int  n = cfg.n, q = cfg.q, T = cfg.T;
+    const bool csv = cfg.csv;
+    const bool indexed = !cfg.index_dir.empty();
+
+    const std::vector<Key>& inserts = w.inserts;
+    const std::vector<Key>& lookups = w.lookups;
 
-    std::vector<int> inserts(n);
-    for (int& x : inserts) x = dist(rng);
-    std::vector<int> lookups(q);
-    for (int& x : lookups) x = dist(rng);
+    std::string path;
+    if constexpr (Persistent<Tree>) {
+        if (indexed) {
+            std::string file = impl;
+            std::replace(file.begin(), file.end(), '/', '_');
+            path = cfg.index_dir + "/" + file + ".idx";
+
+            buildTree<Tree>(cfg, inserts).save(path);
+        }
+    }
+    const std::vector<Key> none;
 
     long long acc_ns = 0,
               acc_c_refs = 0,  acc_c_miss = 0,
               acc_l1_refs = 0, acc_l1_miss = 0,
               acc_l2_refs = 0, acc_l2_miss = 0,
               acc_l3_refs = 0, acc_l3_miss = 0,
-              acc_br = 0,      acc_br_miss = 0;
+              acc_br = 0,      acc_br_miss = 0,
+              acc_dtlb = 0,
+              acc_cyc = 0,     acc_instr = 0,   acc_stall = 0,
+              acc_sort = 0,    acc_layout = 0,
+              acc_open = 0;
 
-    std::size_t bytes_used = 0;
+    std::size_t bytes_used = 0, peak_bytes = 0;
+    std::string prefetch;
+    latency::Histogram lat;
+    const bool sampled = cfg.latency_sample > 0;
 
     for (int t = 0; t < T; ++t) {
-        auto tree = make();
-        Metrics m = benchOnce(*tree, lookups, inserts, measure_construction);
+        std::unique_ptr<Tree> tree;
+        if constexpr (Persistent<Tree>) {
+            if (!path.empty()) {
+                auto t0 = Clock::now();
+                tree = std::make_unique<Tree>(Tree::template open<Tree>(path));
+                acc_open += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+            }
+        }
+        Metrics m = benchOnce(tree, lookups, tree ? none : inserts, cfg, sampled ? &lat : nullptr);
 
         acc_ns      += m.ns;
         acc_c_refs  += m.c_refs;  acc_c_miss  += m.c_miss;
@@ -102,8 +468,12 @@ void runExperiment(int n, int q, int T, bool csv,
         acc_l2_refs += m.l2_refs; acc_l2_miss += m.l2_miss;
         acc_l3_refs += m.l3_refs; acc_l3_miss += m.l3_miss;
         acc_br      += m.branches;acc_br_miss += m.br_miss;
+        acc_dtlb    += m.dtlb_miss;
+        acc_cyc     += m.cycles;  acc_instr   += m.instr;  acc_stall += m.stalls;
+        acc_sort    += m.sort_ns; acc_layout  += m.layout_ns;
+        peak_bytes   = std::max<std::size_t>(peak_bytes, m.peak_bytes);
 
-        if (t == 0) bytes_used = tree->size_bytes();
+        if (t == 0) { bytes_used = tree->size_bytes(); prefetch = prefetchLabel(*tree); }
     }
 
     auto avgLL = [T](long long v){ return double(v) / T; };
@@ -114,6 +484,11 @@ void runExperiment(int n, int q, int T, bool csv,
     double avg_l2_refs  = avgLL(acc_l2_refs), avg_l2_miss = avgLL(acc_l2_miss);
     double avg_l3_refs  = avgLL(acc_l3_refs), avg_l3_miss = avgLL(acc_l3_miss);
     double avg_br       = avgLL(acc_br),      avg_br_miss = avgLL(acc_br_miss);
+    double avg_dtlb     = avgLL(acc_dtlb);
+    double avg_cyc      = avgLL(acc_cyc),     avg_instr   = avgLL(acc_instr);
+    double avg_stall    = avgLL(acc_stall);
+    double avg_sort     = avgLL(acc_sort),    avg_layout  = avgLL(acc_layout);
+    double avg_open     = avgLL(acc_open);
 
     auto rate = [](double miss, double ref){ return ref ? miss / ref : 0.0; };
 
@@ -123,9 +498,22 @@ void runExperiment(int n, int q, int T, bool csv,
     double l2_rate      = rate(avg_l2_miss, avg_l2_refs);
     double l3_rate      = rate(avg_l3_miss, avg_l3_refs);
     double br_rate      = rate(avg_br_miss, avg_br);
+    double dtlb_per_op  = avg_dtlb / q;
+    double cyc_per_op   = avg_cyc / q;
+    double ipc          = rate(avg_instr, avg_cyc);
+    double stall_rate   = rate(avg_stall, avg_cyc);
 
     double bytes_mb     = bytes_used / 1024.0 / 1024.0;
 
+    // p50, p90, p99, p99.9 and max of the sampled lookups in ns
+    std::array<double, 5> tail{};
+    if (sampled) {
+        const double tpn = latency::ticksPerNs();
+        const double ps[] = {0.5, 0.9, 0.99, 0.999};
+        for (int i = 0; i < 4; ++i) tail[i] = lat.percentile(ps[i]) / tpn;
+        tail[4] = lat.max() / tpn;
+    }
+
     if (csv) {
         std::cout << impl << ','
                   << n << ',' << q << ','
@@ -137,11 +525,21 @@ void runExperiment(int n, int q, int T, bool csv,
                   << avg_l1_refs << ',' << avg_l1_miss << ',' << l1_rate << ','
                   << avg_l2_refs << ',' << avg_l2_miss << ',' << l2_rate << ','
                   << avg_l3_refs << ',' << avg_l3_miss << ',' << l3_rate << ','
-                  << avg_br << ',' << avg_br_miss << ',' << br_rate
-                  << '\n';
+                  << avg_br << ',' << avg_br_miss << ',' << br_rate << ','
+                  << avg_dtlb << ',' << dtlb_per_op << ','
+                  << avg_cyc << ',' << avg_instr << ',' << avg_stall << ','
+                  << cyc_per_op << ',' << ipc << ',' << stall_rate << ','
+                  << prefetch;
+        if (cfg.measure_construction)
+            std::cout << ',' << avg_sort << ',' << avg_layout << ',' << peak_bytes;
+        if (indexed)
+            std::cout << ',' << avg_open;
+        if (sampled)
+            for (double v : tail) std::cout << ',' << std::llround(v);
+        std::cout << '\n';
     } else {
     std::cout << std::left << std::fixed <<  std::setprecision(2)
-              << std::setw(22)  << impl
+              << std::setw(36)  << impl
               << std::setw(8)  << n
               << std::setw(8)  << q
               << std::setw(14) << std::setprecision(0) << avg_ns
@@ -164,35 +562,398 @@ void runExperiment(int n, int q, int T, bool csv,
               << std::setw(12) << std::setprecision(0) << avg_br
               << std::setw(12) << avg_br_miss
               << std::setw(10) << std::setprecision(6) << br_rate
-              << '\n';
+              << std::setw(12) << std::setprecision(0) << avg_dtlb
+              << std::setw(10) << std::setprecision(2) << dtlb_per_op
+              << std::setw(10) << std::setprecision(1) << cyc_per_op
+              << std::setw(8)  << std::setprecision(2) << ipc
+              << std::setw(12) << std::setprecision(4) << stall_rate
+              << std::setw(10) << prefetch;
+    if (cfg.measure_construction)
+        std::cout << std::setw(12) << std::setprecision(2) << avg_sort / 1e6
+                  << std::setw(12) << avg_layout / 1e6
+                  << std::setw(10) << std::setprecision(1) << peak_bytes / 1024.0 / 1024.0;
+    if (indexed)
+        std::cout << std::setw(12) << std::setprecision(3) << avg_open / 1e6;
+    if (sampled)
+        for (double v : tail) std::cout << std::setw(10) << std::setprecision(0) << v;
+    std::cout << '\n';
 }
 }
 
+void pinToCpu(unsigned cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Splits the lookups across `threads` pinned readers of one frozen tree.
+// Every reader opens its own counters (they only count the calling
+// thread) and all of them are released together; wall_ns spans from the
+// release to the last reader finishing.
+template<class Tree, class Key>
+std::vector<Metrics> benchThreads(const Tree& tree,
+                                  const std::vector<Key>& lookups,
+                                  unsigned threads, const Config& cfg,
+                                  long long& wall_ns)
+{
+    const std::size_t batch = cfg.query_kind == Query::Contains ? cfg.batch : 0;
+    std::vector<Metrics>     out(threads);
+    std::vector<std::thread> pool;
+    std::atomic<unsigned>    ready{0};
+    std::atomic<bool>        go{false};
+    const std::size_t chunk = (lookups.size() + threads - 1) / threads;
+
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            pinToCpu(t);
+            std::size_t b = std::min(lookups.size(), t * chunk);
+            std::size_t e = std::min(lookups.size(), b + chunk);
+            std::span<const Key> mine(lookups.data() + b, e - b);
+            std::unique_ptr<bool[]> hits(new bool[mine.size()]);
+
+            PerfCounters pc;
+            ++ready;
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+
+            std::size_t found = 0;
+            pc.start();
+            auto t0 = Clock::now();
+            if (batch)
+                tree.Tree::contains_batch(mine, std::span<bool>(hits.get(), mine.size()));
+            else
+                found = runQueries(tree, mine, cfg);
+            auto t1 = Clock::now();
+            pc.stop();
+            if (batch) found = std::count(hits.get(), hits.get() + mine.size(), true);
+            keep(found);
+
+            out[t].ns  = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            out[t].ops = mine.size();
+            readCounters(out[t], pc);
+        });
+    }
+
+    while (ready.load() < threads) std::this_thread::yield();
+    auto w0 = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& th : pool) th.join();
+    wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - w0).count();
+    return out;
+}
+
+void printScalingRow(bool csv, const std::string& impl, int n, int q,
+                     unsigned threads, const std::string& who,
+                     const Metrics& m, double mops)
+{
+    double ns_per_op = m.ops ? double(m.ns) / m.ops : 0.0;
+    if (csv) {
+        std::cout << impl << ',' << n << ',' << q << ','
+                  << threads << ',' << who << ','
+                  << m.ns << ',' << ns_per_op << ',' << mops << ','
+                  << m.c_refs << ',' << m.c_miss << ','
+                  << m.l1_refs << ',' << m.l1_miss << ','
+                  << m.l2_refs << ',' << m.l2_miss << ','
+                  << m.l3_refs << ',' << m.l3_miss << ','
+                  << m.branches << ',' << m.br_miss << ','
+                  << m.dtlb_miss << ','
+                  << m.cycles << ',' << m.instr << ',' << m.stalls << '\n';
+    } else {
+        std::cout << std::left << std::fixed
+                  << std::setw(36) << impl
+                  << std::setw(10) << n
+                  << std::setw(10) << q
+                  << std::setw(8)  << threads
+                  << std::setw(6)  << who
+                  << std::setw(14) << m.ns
+                  << std::setw(12) << std::setprecision(2) << ns_per_op
+                  << std::setw(10) << mops
+                  << std::setw(12) << m.c_refs
+                  << std::setw(12) << m.c_miss
+                  << std::setw(12) << m.l1_refs
+                  << std::setw(12) << m.l1_miss
+                  << std::setw(12) << m.l3_refs
+                  << std::setw(12) << m.l3_miss
+                  << std::setw(12) << m.branches
+                  << std::setw(12) << m.br_miss
+                  << std::setw(12) << m.dtlb_miss
+                  << std::setw(14) << m.cycles
+                  << std::setw(14) << m.instr
+                  << '\n';
+    }
+}
+
+// Read scaling: one frozen tree, 1..threads readers. For every thread
+// count a row per reader (best of T) and an aggregate "all" row whose
+// ns/search is wall time per lookup and whose counters are the sums.
+template<class Tree, class Key>
+void runScaling(const Config& cfg, const std::string& impl, const workload::Stream<Key>& w)
+{
+    const std::vector<Key>& inserts = w.inserts;
+    const std::vector<Key>& lookups = w.lookups;
+
+    auto tree = std::make_unique<Tree>(buildTree<Tree>(cfg, inserts));
+    if (cfg.batch) tree->set_group(cfg.batch);
+
+    for (unsigned threads = 1; threads <= cfg.threads; ++threads) {
+        std::vector<Metrics> best;
+        long long best_wall = 0;
+        for (int t = 0; t < cfg.T; ++t) {
+            long long wall = 0;
+            auto per = benchThreads(*tree, lookups, threads, cfg, wall);
+            if (best.empty() || wall < best_wall) { best = std::move(per); best_wall = wall; }
+        }
+
+        Metrics all;
+        all.ns  = best_wall;
+        all.ops = lookups.size();
+        for (unsigned t = 0; t < threads; ++t) {
+            const Metrics& m = best[t];
+            all.c_refs  += m.c_refs;  all.c_miss  += m.c_miss;
+            all.l1_refs += m.l1_refs; all.l1_miss += m.l1_miss;
+            all.l2_refs += m.l2_refs; all.l2_miss += m.l2_miss;
+            all.l3_refs += m.l3_refs; all.l3_miss += m.l3_miss;
+            all.branches += m.branches; all.br_miss += m.br_miss;
+            all.dtlb_miss += m.dtlb_miss;
+            all.cycles += m.cycles; all.instr += m.instr; all.stalls += m.stalls;
+            double mops = m.ns ? m.ops * 1e3 / m.ns : 0.0;
+            printScalingRow(cfg.csv, impl, cfg.n, cfg.q, threads, std::to_string(t), m, mops);
+        }
+        double mops = best_wall ? all.ops * 1e3 / best_wall : 0.0;
+        printScalingRow(cfg.csv, impl, cfg.n, cfg.q, threads, "all", all, mops);
+    }
+}
+
+// Mixed read/write mode: the tree is bulk loaded with the n inserts, then
+// q operations run in rounds of kRound, write_frac of them writes (a new
+// key, or with delete_frac an erase of an inserted one) followed by
+// lookups. Writes and reads are timed per block, so the reported ns/write
+// includes the amortised merges and ns/read the levels they leave behind.
+template<class Tree, class Key>
+void runMixed(const Config& cfg, const std::string& impl, const workload::Stream<Key>& w)
+{
+    constexpr std::size_t kRound = 1024;
+
+    const std::vector<Key>& inserts = w.inserts;
+    const std::vector<Key>& lookups = w.lookups;
+
+    const std::size_t W = std::min<std::size_t>(kRound, std::llround(kRound * cfg.write_frac));
+    const std::size_t R = kRound - W;
+    const std::size_t rounds = (static_cast<std::size_t>(cfg.q) + kRound - 1) / kRound;
+
+    std::mt19937 rng(cfg.seed + 1);
+    std::uniform_int_distribution<int> dist(1, cfg.n * 10);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::vector<std::pair<Key, bool>> writes(rounds * W);    // (key, erase)
+    for (auto& w : writes) {
+        bool erase = !inserts.empty() && coin(rng) < cfg.delete_frac;
+        w = {erase ? inserts[rng() % inserts.size()] : makeKey<Key>(dist(rng)), erase};
+    }
+
+    long long acc_w = 0, acc_r = 0, acc_merge = 0;
+    std::size_t levels = 0, bytes_used = 0;
+    std::size_t reads = 0;       // lookups run per repetition; the last block may be short
+    for (int t = 0; t < cfg.T; ++t) {
+        Tree tree(inserts);
+        if (cfg.batch) tree.set_group(cfg.batch);
+        std::unique_ptr<bool[]> hits(new bool[R]);
+        std::size_t found = 0, next_read = 0;
+
+        for (std::size_t r = 0; r < rounds; ++r) {
+            auto t0 = Clock::now();
+            for (std::size_t i = r * W; i < (r + 1) * W; ++i) {
+                if (writes[i].second) tree.Tree::erase(writes[i].first);
+                else                  tree.Tree::insert(writes[i].first);
+            }
+            auto t1 = Clock::now();
+            std::span<const Key> block(lookups.data() + next_read,
+                                       std::min(R, lookups.size() - next_read));
+            if (cfg.batch) {
+                tree.Tree::contains_batch(block, std::span<bool>(hits.get(), block.size()));
+                found += std::count(hits.get(), hits.get() + block.size(), true);
+            } else {
+                for (const auto& k : block) found += tree.Tree::contains(k);
+            }
+            auto t2 = Clock::now();
+            next_read = (next_read + block.size()) % std::max<std::size_t>(lookups.size(), 1);
+            if (t == 0) reads += block.size();
+
+            acc_w += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            acc_r += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        }
+        keep(found);
+        acc_merge += tree.build_stats().layout_ns;
+        if (t == 0) { levels = tree.levels(); bytes_used = tree.size_bytes(); }
+    }
+
+    const double writes_total = double(rounds * W) * cfg.T;
+    const double reads_total  = double(reads) * cfg.T;
+    const double ns_write = writes_total ? acc_w / writes_total : 0.0;
+    const double ns_read  = reads_total  ? acc_r / reads_total  : 0.0;
+    const double merge_ms = acc_merge / 1e6 / cfg.T;
+
+    if (cfg.csv) {
+        std::cout << impl << ',' << cfg.n << ',' << cfg.q << ','
+                  << rounds * W << ',' << reads << ','
+                  << ns_write << ',' << ns_read << ',' << merge_ms << ','
+                  << levels << ',' << bytes_used << '\n';
+    } else {
+        std::cout << std::left << std::fixed << std::setprecision(2)
+                  << std::setw(36) << impl
+                  << std::setw(10) << cfg.n
+                  << std::setw(10) << cfg.q
+                  << std::setw(10) << rounds * W
+                  << std::setw(10) << reads
+                  << std::setw(12) << ns_write
+                  << std::setw(12) << ns_read
+                  << std::setw(12) << merge_ms
+                  << std::setw(8)  << levels
+                  << std::setw(8)  << std::setprecision(1) << bytes_used / 1024.0 / 1024.0
+                  << '\n';
+    }
+}
+
+template<class Key, bool Huge>
+void runRegistry(const Config& cfg)
+{
+    const auto stream = makeWorkload<Key>(cfg);
+
+    if (cfg.write_frac > 0) {
+        auto mixed = [&]<class Tree>(Impl<Tree> v) {
+            if (cfg.impl != "ALL" && cfg.impl != v.name) return;
+            std::string label = v.name;
+            if (cfg.key_type != "int") label += "/" + cfg.key_type;
+            if (cfg.batch)             label += "/G" + std::to_string(cfg.batch);
+            if (cfg.huge_pages)        label += "/huge";
+            runMixed<Tree, Key>(cfg, label, stream);
+        };
+        std::apply([&](auto... v) { (mixed(v), ...); }, dynamicRegistry<Key, Huge>());
+        return;
+    }
+
+    auto run = [&]<class Tree>(Impl<Tree> v) {
+        if (cfg.impl != "ALL" && cfg.impl != v.name) return;
+        if (!supports<Tree>(cfg)) return;
+        std::string label = v.name;
+        if (cfg.key_type != "int") label += "/" + cfg.key_type;
+        if (cfg.batch)             label += "/G" + std::to_string(cfg.batch);
+        if (cfg.huge_pages)        label += "/huge";
+        if (cfg.query_kind != Query::Contains) label += "/" + cfg.query;
+        if (cfg.multiset)          label += "/multi";
+        if (cfg.in_place)          label += "/inplace";
+        if (cfg.threads) runScaling<Tree, Key>(cfg, label, stream);
+        else             runExperiment<Tree, Key>(cfg, label, stream);
+    };
+    std::apply([&](auto... v) { (run(v), ...); }, registry<Key, Huge>());
+}
+
+template<class Key>
+void runVariants(const Config& cfg)
+{
+    if (cfg.huge_pages) runRegistry<Key, true>(cfg);
+    else                runRegistry<Key, false>(cfg);
+}
+
 int main(int argc, char* argv[])
 {
-    int  n = 10000, q = 10000, T = 1;
-    bool csv = false;
-    unsigned seed = 42;
-    std::string impl = "ALL";
-    bool measure_construction = true;
+    Config c;
 
     if (argc >= 2) {
         std::ifstream in(argv[1]);
         if (!in) { std::cerr << "Cannot open " << argv[1] << '\n'; return 1; }
         json cfg; in >> cfg;
-        if (cfg.contains("n"))    n    = cfg["n"];
-        if (cfg.contains("q"))    q    = cfg["q"];
-        if (cfg.contains("T"))    T    = cfg["T"];
-        if (cfg.contains("csv"))  csv  = cfg["csv"];
-        if (cfg.contains("seed")) seed = cfg["seed"];
-        if (cfg.contains("impl")) impl = cfg["impl"];
-        if (cfg.contains("measure_construction")) measure_construction = cfg["measure_construction"];
+        if (cfg.contains("n"))    c.n    = cfg["n"];
+        if (cfg.contains("q"))    c.q    = cfg["q"];
+        if (cfg.contains("T"))    c.T    = cfg["T"];
+        if (cfg.contains("csv"))  c.csv  = cfg["csv"];
+        if (cfg.contains("seed")) c.seed = cfg["seed"];
+        if (cfg.contains("impl")) c.impl = cfg["impl"];
+        if (cfg.contains("measure_construction")) c.measure_construction = cfg["measure_construction"];
+        if (cfg.contains("batch")) c.batch = cfg["batch"];
+        if (cfg.contains("key_type")) c.key_type = cfg["key_type"];
+        if (cfg.contains("threads")) c.threads = cfg["threads"];
+        if (cfg.contains("huge_pages")) c.huge_pages = cfg["huge_pages"];
+        if (cfg.contains("index_dir")) c.index_dir = cfg["index_dir"];
+        if (cfg.contains("query")) c.query = cfg["query"];
+        if (cfg.contains("scan_len")) c.scan_len = cfg["scan_len"];
+        if (cfg.contains("multiset")) c.multiset = cfg["multiset"];
+        if (cfg.contains("write_frac")) c.write_frac = cfg["write_frac"];
+        if (cfg.contains("delete_frac")) c.delete_frac = cfg["delete_frac"];
+        if (cfg.contains("latency_sample")) c.latency_sample = cfg["latency_sample"];
+        if (cfg.contains("key_dist")) c.workload.key_dist = cfg["key_dist"];
+        if (cfg.contains("key_sigma")) c.workload.key_sigma = cfg["key_sigma"];
+        if (cfg.contains("dist")) c.workload.dist = cfg["dist"];
+        if (cfg.contains("zipf_s")) c.workload.zipf_s = cfg["zipf_s"];
+        if (cfg.contains("hit_ratio")) c.workload.hit_ratio = cfg["hit_ratio"];
+        if (cfg.contains("order")) c.workload.order = cfg["order"];
+        if (cfg.contains("disorder")) c.workload.disorder = cfg["disorder"];
+        if (cfg.contains("window")) c.workload.window = cfg["window"];
+        if (cfg.contains("trace")) c.workload.trace = cfg["trace"];
+        if (cfg.contains("calibrate_prefetch")) c.calibrate_prefetch = cfg["calibrate_prefetch"];
+        if (cfg.contains("in_place")) c.in_place = cfg["in_place"];
     }
-    if (argc == 3) impl = argv[2];
+    if (argc == 3) c.impl = argv[2];
 
-    if (!csv) {
+    if      (c.query == "contains")    c.query_kind = Query::Contains;
+    else if (c.query == "lower_bound") c.query_kind = Query::LowerBound;
+    else if (c.query == "upper_bound") c.query_kind = Query::UpperBound;
+    else if (c.query == "rank")        c.query_kind = Query::Rank;
+    else if (c.query == "count_range") c.query_kind = Query::CountRange;
+    else if (c.query == "scan")        c.query_kind = Query::Scan;
+    else { std::cerr << "Unknown query " << c.query << '\n'; return 1; }
+    if (auto err = workload::check(c.workload); !err.empty()) { std::cerr << err << '\n'; return 1; }
+
+    if (c.write_frac > 0) {
+        if (c.csv)
+            std::cout << "impl,n,q,writes,reads,ns_per_write,ns_per_read,merge_ms,levels,bytes\n";
+        else
+            std::cout << std::left
+                      << std::setw(36) << "impl"
+                      << std::setw(10) << "n"
+                      << std::setw(10) << "q"
+                      << std::setw(10) << "writes"
+                      << std::setw(10) << "reads"
+                      << std::setw(12) << "ns/write"
+                      << std::setw(12) << "ns/read"
+                      << std::setw(12) << "merge_ms"
+                      << std::setw(8)  << "levels"
+                      << std::setw(8)  << "MB"
+                      << '\n'
+                      << std::string(128, '-') << '\n';
+    } else if (c.threads) {
+        if (c.csv)
+            std::cout << "impl,n,q,threads,thread,ns,ns_per_search,mops,"
+                         "cache_refs,cache_misses,l1_refs,l1_misses,"
+                         "l2_refs,l2_misses,l3_refs,l3_misses,"
+                         "branches,branch_misses,dtlb_misses,"
+                         "cycles,instructions,stalled_cycles\n";
+        else
+            std::cout << std::left
+                      << std::setw(36) << "impl"
+                      << std::setw(10) << "n"
+                      << std::setw(10) << "q"
+                      << std::setw(8)  << "threads"
+                      << std::setw(6)  << "thr"
+                      << std::setw(14) << "ns"
+                      << std::setw(12) << "ns/search"
+                      << std::setw(10) << "Mops/s"
+                      << std::setw(12) << "c_refs"
+                      << std::setw(12) << "c_miss"
+                      << std::setw(12) << "L1_refs"
+                      << std::setw(12) << "L1_miss"
+                      << std::setw(12) << "L3_refs"
+                      << std::setw(12) << "L3_miss"
+                      << std::setw(12) << "branches"
+                      << std::setw(12) << "br_miss"
+                      << std::setw(12) << "dTLB_miss"
+                      << std::setw(14) << "cycles"
+                      << std::setw(14) << "instr"
+                      << '\n'
+                      << std::string(254, '-') << '\n';
+    } else if (!c.csv) {
     std::cout << std::left
-              << std::setw(22)  << "impl"
+              << std::setw(36) << "impl"
               << std::setw(8)  << "n"
               << std::setw(8)  << "q"
               << std::setw(14) << "total_ns"
@@ -215,20 +976,44 @@ int main(int argc, char* argv[])
               << std::setw(12) << "branches"
               << std::setw(12) << "br_miss"
               << std::setw(10) << "br_rate"
-              << '\n'
-              << std::string(255, '-') << '\n';
-}else if(csv && impl == "BST_VEB" && 1 == 2) {
+              << std::setw(12) << "dTLB_miss"
+              << std::setw(10) << "dTLB/sea"
+              << std::setw(10) << "cyc/sea"
+              << std::setw(8)  << "IPC"
+              << std::setw(12) << "stall_rate"
+              << std::setw(10) << "prefetch";
+    if (c.measure_construction)
+        std::cout << std::setw(12) << "sort_ms"
+                  << std::setw(12) << "layout_ms"
+                  << std::setw(10) << "peak_MB";
+    if (!c.index_dir.empty())
+        std::cout << std::setw(12) << "open_ms";
+    if (c.latency_sample)
+        for (const char* h : {"p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns"})
+            std::cout << std::setw(10) << h;
+    std::cout << '\n'
+              << std::string(331, '-') << '\n';
+} else {
+        // the columns of the runExperiment row, under the same conditions
         std::cout << "impl,n,q,total_ns,total_s,ns_per_search,"
                      "cache_refs,cache_misses,misses_per_search,miss_rate,bytes,"
                      "l1_refs,l1_misses,l1_rate,"
                      "l2_refs,l2_misses,l2_rate,"
                      "l3_refs,l3_misses,l3_rate,"
-                     "branches,branch_misses,branch_rate\n";
+                     "branches,branch_misses,branch_rate,"
+                     "dtlb_misses,dtlb_misses_per_search,"
+                     "cycles,instructions,stalled_cycles,"
+                     "cycles_per_search,ipc,stall_rate,prefetch";
+        if (c.measure_construction) std::cout << ",sort_ns,layout_ns,peak_bytes";
+        if (!c.index_dir.empty())   std::cout << ",open_ns";
+        if (c.latency_sample)       std::cout << ",p50_ns,p90_ns,p99_ns,p999_ns,max_ns";
+        std::cout << '\n';
     }
 
-    for (const auto& v : variants) {
-        if (impl != "ALL" && impl != v.name) continue;
-        runExperiment(n, q, T, csv, v.make, seed, v.name, measure_construction);
-    }
+    if      (c.key_type == "int")    runVariants<int>(c);
+    else if (c.key_type == "uint64") runVariants<std::uint64_t>(c);
+    else if (c.key_type == "double") runVariants<double>(c);
+    else if (c.key_type == "str16")  runVariants<FixedString<16>>(c);
+    else { std::cerr << "Unknown key_type " << c.key_type << '\n'; return 1; }
     return 0;
 }
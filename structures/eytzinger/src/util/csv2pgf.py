@@ -29,6 +29,7 @@ parser.add_argument(
     nargs="+",
     default=[
         "BST_VEB",
+        "BST_PRE",
         "BST_EYT",
         "BST_EYT_PREF",
         "BST_EYT_PREF_TWO",
@@ -44,6 +45,7 @@ args = parser.parse_args()
 
 styles = {
     "BST_VEB":            dict(color="red",    line="dotted",        mark="triangle*"),
+    "BST_PRE":            dict(color="magenta", line="dotted",       mark="triangle"),
     "BST_EYT":            dict(color="blue",   line="dashed",        mark="square*"),
     "BST_EYT_PREF":       dict(color="green!70!black", line="solid",       mark="*"),
     "BST_EYT_PREF_TWO":   dict(color="orange", line="dashdotted",    mark="diamond*"),
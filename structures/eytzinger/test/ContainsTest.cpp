@@ -3,19 +3,50 @@
 #include <iostream>
 
 #include "../include/BSTVEB.h"
+#include "../include/BSTPreorder.h"
 #include "../include/BSTEyt.h"
 #include "../include/BSTEytPrefetch.h"
 #include "../include/BSTEytPrefetchTwo.h"
 #include "../include/BSTEytPrefetchThree.h"
 #include "../include/BSTEytPrefetchFour.h"
 #include "../include/BSTEytPrefetchProb.h"
+#include "../include/BSTEytBranchless.h"
+#include "../include/BSTSTree.h"
+#include "../include/KeyTraits.h"
+#include "../include/HugePageAllocator.h"
+#include "../include/Builder.h"
+#include "../include/BSTLsm.h"
+#include "../include/BSTEytCompressed.h"
+#include "../include/BSTEytAdaptive.h"
+#include "../include/BSTEytAligned.h"
+#include "../include/BSTPgm.h"
+#include "../include/RadixSort.h"
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <span>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <set>
+#include <random>
+#include <climits>
+#include <limits>
 
 
 template<class Tree>
 void sanity_check(std::size_t N = 1'024)
 {
-    Tree t;
-    for (std::size_t i = 0; i < N; ++i) t.insert(static_cast<int>(i * 2));
+    Builder<Tree> b;
+    for (std::size_t i = 0; i < N; ++i) b.insert(static_cast<int>(i * 2));
+    Tree t = b.build();
 
     for (std::size_t i = 0; i < N; ++i) {
         int present = static_cast<int>(i * 2);
@@ -25,15 +56,488 @@ void sanity_check(std::size_t N = 1'024)
     }
 }
 
+template<class Tree>
+void lower_bound_check()
+{
+    for (std::size_t N : {0, 1, 2, 3, 7, 8, 16, 17, 100, 1'023, 1'024, 1'025, 5'000}) {
+        std::vector<int> keys;
+        for (std::size_t i = 0; i < N; ++i) keys.push_back(static_cast<int>(i * 3));
+        Tree t(keys);
+        for (int k = -1; k <= static_cast<int>(N * 3) + 1; ++k) {
+            auto it  = std::lower_bound(keys.begin(), keys.end(), k);
+            auto got = t.lower_bound(k);
+            assert(got.has_value() == (it != keys.end()) && "lower_bound presence");
+            assert((!got || *got == *it) && "lower_bound value");
+        }
+    }
+}
+
+template<class Tree>
+void batch_check(std::size_t group, std::size_t N = 1'000)
+{
+    Builder<Tree> b;
+    for (std::size_t i = 0; i < N; ++i) b.insert(static_cast<int>(i * 2));
+    Tree t = b.build();
+    t.set_group(group);
+
+    std::vector<int> q;
+    for (int k = -2; k <= static_cast<int>(N * 2) + 2; ++k) q.push_back(k);
+    std::unique_ptr<bool[]> hit(new bool[q.size()]);
+    std::vector<std::optional<int>> lb(q.size());
+    t.contains_batch(q, std::span<bool>(hit.get(), q.size()));
+    t.lower_bound_batch(q, lb);
+
+    for (std::size_t j = 0; j < q.size(); ++j) {
+        assert(hit[j] == t.contains(q[j]) && "batch contains mismatch");
+        assert(lb[j]  == t.lower_bound(q[j]) && "batch lower_bound mismatch");
+    }
+}
+
+// A saved index reopened through mmap must answer exactly like the tree
+// it was written from; a file of another layout must be rejected.
+template<class Tree, class Other>
+void index_file_check(std::size_t N = 1'000)
+{
+    const std::string path = "/tmp/eyt_index_test.idx";
+    Builder<Tree> b;
+    for (std::size_t i = 0; i < N; ++i) b.insert(static_cast<int>(i * 2));
+    Tree t = b.build();
+    t.save(path);
+
+    Tree m = Tree::template open<Tree>(path, true);
+    assert(m.size_bytes() == t.size_bytes() && "mapped size mismatch");
+    for (int k = -2; k <= static_cast<int>(N * 2) + 2; ++k) {
+        assert(m.contains(k) == t.contains(k) && "mapped contains mismatch");
+        assert(m.lower_bound(k) == t.lower_bound(k) && "mapped lower_bound mismatch");
+    }
+
+    bool rejected = false;
+    try { (void)Other::open(path); }
+    catch (const std::runtime_error&) { rejected = true; }
+    assert(rejected && "layout mismatch not detected");
+    std::remove(path.c_str());
+}
+
+// A header whose key count overflows n * sizeof(Key) must be rejected as
+// truncated rather than mapped past the end of the file.
+void index_file_corrupt_check()
+{
+    const std::string path = "/tmp/eyt_index_corrupt.idx";
+    BSTEyt<int>(std::vector<int>{1, 2, 3}).save(path);
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        const std::uint64_t n = (std::uint64_t(1) << 62) + 1;   // * 4 wraps to 4
+        f.seekp(offsetof(index_file::Header, n));
+        f.write(reinterpret_cast<const char*>(&n), sizeof n);
+    }
+    bool rejected = false;
+    try { (void)BSTEyt<int>::open(path); }
+    catch (const std::runtime_error&) { rejected = true; }
+    assert(rejected && "overflowing key count not detected");
+    std::remove(path.c_str());
+}
+
+// Ordered queries against a sorted reference; in multiset mode every key
+// i*3 is inserted i%3+1 times and the counts must include the copies.
+template<class Tree>
+void ordered_check(KeyMode mode)
+{
+    for (std::size_t N : {0, 1, 2, 3, 7, 8, 16, 17, 100, 1'023, 1'024, 1'025}) {
+        std::vector<int> ref;
+        for (std::size_t i = 0; i < N; ++i)
+            for (std::size_t c = 0; c <= (mode == KeyMode::Multiset ? i % 3 : 0); ++c)
+                ref.push_back(static_cast<int>(i * 3));
+        std::vector<int> shuffled(ref.rbegin(), ref.rend());
+        Tree t(shuffled, mode);
+
+        std::vector<int> distinct(t.begin(), t.end());
+        std::vector<int> uniq = ref;
+        uniq.erase(std::unique(uniq.begin(), uniq.end()), uniq.end());
+        assert(distinct == uniq && "in-order iteration");
+
+        const int hiKey = static_cast<int>(N * 3) + 1;
+        for (int k = -1; k <= hiKey; ++k) {
+            auto lo = std::lower_bound(ref.begin(), ref.end(), k);
+            auto up = std::upper_bound(ref.begin(), ref.end(), k);
+            auto ub = t.upper_bound(k);
+            assert(ub.has_value() == (up != ref.end()) && "upper_bound presence");
+            assert((!ub || *ub == *up) && "upper_bound value");
+            assert(t.rank(k) == std::uint64_t(lo - ref.begin()) && "rank");
+            assert(t.count(k) == std::uint64_t(up - lo) && "count");
+
+            const int k2 = k + 7;
+            auto hi = std::lower_bound(ref.begin(), ref.end(), k2);
+            assert(t.count_range(k, k2) == std::uint64_t(hi - lo) && "count_range");
+            assert(t.count_range(k2, k) == 0 && "empty count_range");
+
+            std::uint64_t seen = 0;
+            int prev = k - 1;
+            auto r = t.range(k, k2);
+            for (auto it = r.begin(); it != r.end(); ++it) {
+                assert(*it >= k && *it < k2 && *it > prev && "range scan order");
+                prev = *it;
+                seen += it.multiplicity();
+            }
+            assert(seen == std::uint64_t(hi - lo) && "range scan size");
+        }
+    }
+}
+
+// Random inserts and deletes against std::set, with a tiny buffer so the
+// keys cascade through many levels.
+void lsm_check(std::size_t ops = 20'000)
+{
+    BSTLsm<int> t(8, 2);
+    std::set<int> ref;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> key(0, 2'000);
+
+    for (std::size_t i = 0; i < ops; ++i) {
+        int k = key(rng);
+        if (rng() % 3 == 0) { t.erase(k);  ref.erase(k); }
+        else                { t.insert(k); ref.insert(k); }
+
+        if (i % 997 == 0) {
+            std::vector<int> q;
+            for (int x = -1; x <= 2'001; ++x) q.push_back(x);
+            std::unique_ptr<bool[]> hit(new bool[q.size()]);
+            t.set_group(1 + i % 16);
+            t.contains_batch(q, std::span<bool>(hit.get(), q.size()));
+            for (std::size_t j = 0; j < q.size(); ++j) {
+                bool in = ref.count(q[j]);
+                assert(t.contains(q[j]) == in && "lsm contains");
+                assert(hit[j] == in && "lsm contains_batch");
+                auto it = ref.lower_bound(q[j]);
+                auto lb = t.lower_bound(q[j]);
+                assert(lb.has_value() == (it != ref.end()) && "lsm lower_bound presence");
+                assert((!lb || *lb == *it) && "lsm lower_bound value");
+            }
+        }
+    }
+    assert(t.levels() > 1 && "lsm never cascaded");
+
+    std::vector<int> bulk(ref.begin(), ref.end());
+    BSTLsm<int> b(bulk, 8, 2);
+    for (int x = -1; x <= 2'001; ++x) assert(b.contains(x) == (ref.count(x) == 1) && "lsm bulk load");
+}
+
+// Dense runs separated by gaps wider than 16 bits, plus the extremes of
+// int, so the tree mixes narrow and wide stripes.
+void compressed_check(std::size_t N = 200'000)
+{
+    std::mt19937 rng(11);
+    std::vector<int> keys{INT_MIN, INT_MIN + 1, INT_MAX - 1, INT_MAX};
+    int x = -1'000'000'000;
+    for (std::size_t i = 0; i < N; ++i) {
+        x += rng() % 64 == 0 ? 100'000 + int(rng() % 1'000'000) : 1 + int(rng() % 8);
+        keys.push_back(x);
+    }
+    BSTEytCompressed<int> t(keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<int> q{INT_MIN, INT_MIN + 2, 0, INT_MAX - 2, INT_MAX};
+    for (std::size_t i = 0; i < 4 * N; ++i) q.push_back(keys[rng() % keys.size()] + int(rng() % 5) - 2);
+    for (int k : q) {
+        auto it = std::lower_bound(keys.begin(), keys.end(), k);
+        auto lb = t.lower_bound(k);
+        assert(lb.has_value() == (it != keys.end()) && "compressed lower_bound presence");
+        assert((!lb || *lb == *it) && "compressed lower_bound value");
+        assert(t.contains(k) == (it != keys.end() && *it == k) && "compressed contains");
+    }
+
+    // a perfect tree, and sizes where most of the last level is padding
+    for (std::size_t M : {(1 << 20) - 1, (1 << 20) + 1, (1 << 16) + 33, 31, 32, 33, 1, 0}) {
+        std::vector<int> dense(M);
+        for (std::size_t i = 0; i < M; ++i) dense[i] = int(i * 3);
+        BSTEytCompressed<int> d(dense);
+        for (int k = -1; k <= int(M * 3) + 1; ++k) {
+            auto lb = d.lower_bound(k);
+            assert(lb.has_value() == (k <= int(M * 3) - 3) && "compressed padded presence");
+            assert((!lb || *lb == (k + 2) / 3 * 3) && "compressed padded value");
+        }
+        if (M > 1'000)
+            assert(d.size_bytes() < BSTEyt<int>(dense).size_bytes() * 6 / 10 && "not compressed");
+    }
+}
+
+// The plan follows the cache sizes, and whatever depth calibration picks
+// the answers stay the same.
+void adaptive_check()
+{
+    const auto& c = help::cacheSizes();
+    assert(c.l1 > 0 && c.l1 <= c.l2 && c.l2 <= c.l3 && "cache sizes");
+
+    BSTEytAdaptive<int> tiny(std::vector<int>{1, 2, 3});
+    assert(tiny.prefetch_plan().depth == 0 && "small trees do not prefetch");
+
+    std::vector<int> keys(1 << 18);
+    for (std::size_t i = 0; i < keys.size(); ++i) keys[i] = static_cast<int>(i * 4);
+    BSTEytAdaptive<int> t(keys, KeyMode::Set, true);
+    const auto& p = t.prefetch_plan();
+    assert(p.calibrated && p.depth <= BSTEytAdaptive<int>::kMaxDepth && "calibrated plan");
+    for (int k = -1; k <= static_cast<int>(keys.size() * 4); k += 3) {
+        auto it = std::lower_bound(keys.begin(), keys.end(), k);
+        auto lb = t.lower_bound(k);
+        assert(lb.has_value() == (it != keys.end()) && (!lb || *lb == *it) && "adaptive lower_bound");
+        assert(t.contains(k) == (k >= 0 && k % 4 == 0) && "adaptive contains");
+    }
+}
+
+// Keys bunched at both ends of the range and the extremes of the key
+// type, so the model needs many segments of very different slopes.
+template<class Key>
+void pgm_check(std::size_t N = 200'000)
+{
+    std::mt19937_64 rng(5);
+    std::lognormal_distribution<double> ln(0.0, 2.0);
+    const double lo = double(std::numeric_limits<Key>::lowest()) / 2, hi = double(std::numeric_limits<Key>::max()) / 2;
+    std::vector<Key> keys{std::numeric_limits<Key>::lowest(), std::numeric_limits<Key>::max()};
+    for (std::size_t i = 0; i < N; ++i) {
+        double x = ln(rng);
+        keys.push_back(static_cast<Key>(lo + (hi - lo) * (x / (1 + x))));
+    }
+    BSTPgm<Key> t(keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    assert(t.segments() > 1 && t.model_bytes() < keys.size() * sizeof(Key) && "pgm model");
+
+    std::vector<Key> q{std::numeric_limits<Key>::lowest(), std::numeric_limits<Key>::max(), Key(0)};
+    for (std::size_t i = 0; i < 2 * N; ++i) {
+        q.push_back(keys[rng() % keys.size()]);
+        Key k = keys[rng() % keys.size()];
+        if (k != std::numeric_limits<Key>::lowest() && k != std::numeric_limits<Key>::max())
+            k = rng() % 2 ? k - Key(1) : k + Key(1);
+        q.push_back(k);
+    }
+    for (Key k : q) {
+        auto it = std::lower_bound(keys.begin(), keys.end(), k);
+        auto lb = t.lower_bound(k);
+        assert(lb.has_value() == (it != keys.end()) && (!lb || *lb == *it) && "pgm lower_bound");
+        assert(t.contains(k) == (it != keys.end() && *it == k) && "pgm contains");
+    }
+}
+
+// The radix path against std::sort: signed keys across zero, keys that
+// differ in one byte only, duplicates, and input that is already sorted;
+// with and without the scatter buffer.
+template<class Key>
+void radix_sort_check()
+{
+    std::mt19937_64 rng(3);
+    for (std::size_t n : {0, 5, 4'095, 4'096, 100'003}) {
+        for (std::uint64_t mod : {std::uint64_t(256), std::uint64_t(n) * 10 + 1, ~std::uint64_t(0)}) {
+            std::vector<Key> v(n);
+            for (auto& x : v) x = static_cast<Key>(rng() % mod) - static_cast<Key>(std::is_signed_v<Key> ? mod / 2 : 0);
+            std::vector<Key> want = v;
+            std::sort(want.begin(), want.end());
+
+            std::vector<Key> got = v, flag = v, flagUnique = v;
+            help::sortKeys(got);
+            assert(got == want && "radix sort");
+            help::sortKeys(flag, std::less<Key>{}, true);
+            assert(flag == want && "in-place radix sort");
+            want.erase(std::unique(want.begin(), want.end()), want.end());
+            help::sortUnique(v);
+            assert(v == want && "radix sort unique");
+            help::sortUnique(v);
+            assert(v == want && "sorted input");
+            help::sortUnique(flagUnique, std::less<Key>{}, std::equal_to<Key>{}, true);
+            assert(flagUnique == want && "in-place radix sort unique");
+        }
+    }
+}
+
+// Freeze::InPlace permutes the sorted keys into the same layout Gather
+// writes, for perfect trees and partial last levels alike.
+template<class Tree>
+void in_place_check()
+{
+    for (std::size_t N : {0, 1, 2, 3, 6, 7, 8, 100, 1'023, 1'024, 70'000, 131'073}) {
+        std::vector<int> keys;
+        for (std::size_t i = 0; i < N; ++i) keys.push_back(static_cast<int>((i * 7919) % N * 2));
+        Tree gather(keys), inPlace = [&] {
+            if constexpr (std::is_constructible_v<Tree, std::vector<int>, KeyMode, Freeze>)
+                return Tree(keys, KeyMode::Set, Freeze::InPlace);
+            else
+                return Tree(keys, Freeze::InPlace);
+        }();
+        assert(inPlace.size_bytes() == gather.size_bytes() && "in-place size");
+        for (int k = -1; k <= static_cast<int>(N * 2); ++k) {
+            assert(inPlace.contains(k) == gather.contains(k) && "in-place contains");
+            assert(inPlace.lower_bound(k) == gather.lower_bound(k) && "in-place lower_bound");
+        }
+    }
+}
+
+// Sizes around the topmost cut of the height-split layout, where the
+// bottom subtrees are filled in parallel and the last one is partial.
+void veb_check()
+{
+    for (std::size_t N : {65'535, 65'536, 65'537, 100'003, 131'071, 131'072, 300'000}) {
+        std::vector<int> keys;
+        for (std::size_t i = 0; i < N; ++i) keys.push_back(static_cast<int>(i * 2));
+        BSTVEB<int> t(keys);
+        assert(t.height() == std::bit_width(N) && "veb height");
+        for (int k = -1; k <= static_cast<int>(N * 2); k += 3) {
+            auto got = t.lower_bound(k);
+            assert(got.has_value() == (k < static_cast<int>(N * 2) - 1) && "veb lower_bound presence");
+            assert((!got || *got == (k + 1) / 2 * 2) && "veb lower_bound value");
+        }
+    }
+}
+
+// One tree shared by several readers that all start with the first query
+// at the same time; there is no lazy state left for them to race on.
+template<class Tree>
+void concurrent_check(std::size_t N = 1 << 16, unsigned threads = 4)
+{
+    Builder<Tree> b(N);
+    for (std::size_t i = 0; i < N; ++i) b.insert(static_cast<int>(i * 2));
+    const Tree t = b.build();
+
+    std::atomic<bool>        go{false};
+    std::atomic<std::size_t> wrong{0};
+    std::vector<std::thread> pool;
+    for (unsigned w = 0; w < threads; ++w) {
+        pool.emplace_back([&, w] {
+            while (!go.load()) std::this_thread::yield();
+            for (std::size_t i = w; i < N; i += threads) {
+                int k = static_cast<int>(i * 2);
+                wrong += !t.contains(k) + t.contains(k + 1);
+            }
+        });
+    }
+    go = true;
+    for (auto& th : pool) th.join();
+    assert(wrong == 0 && "concurrent lookups disagree");
+}
+
+// i-th key of an order preserving sequence for every supported key type
+template<class Key>
+Key nth_key(std::size_t i)
+{
+    if constexpr (std::is_same_v<Key, std::uint64_t>) {
+        return (std::uint64_t(i) << 32) | 7;
+    } else if constexpr (std::is_arithmetic_v<Key>) {
+        return static_cast<Key>(i) * Key(1.5);
+    } else {
+        Key k;
+        for (std::size_t b = 0; b < 8; ++b) k.c[7 - b] = static_cast<unsigned char>(i >> (8 * b));
+        return k;
+    }
+}
+
+template<template<class> class Tree, class Key>
+void generic_key_check(std::size_t N = 1'024)
+{
+    Builder<Tree<Key>> b;
+    for (std::size_t i = 0; i < N; ++i) b.insert(nth_key<Key>(2 * i + 1));
+    Tree<Key> t = b.build();
+
+    for (std::size_t i = 0; i <= 2 * N + 1; ++i) {
+        Key k = nth_key<Key>(i);
+        assert(t.contains(k) == (i % 2 == 1 && i < 2 * N) && "generic key membership");
+        auto lb = t.lower_bound(k);
+        assert(lb.has_value() == (i < 2 * N) && "generic key lower_bound presence");
+        assert((!lb || *lb == nth_key<Key>(i | 1)) && "generic key lower_bound value");
+    }
+}
+
+template<class Key>
+void generic_family_check()
+{
+    generic_key_check< BSTVEB,           Key >();
+    generic_key_check< BSTPreorder,      Key >();
+    generic_key_check< BSTEyt,           Key >();
+    generic_key_check< BSTEytPref,       Key >();
+    generic_key_check< BSTEytPrefTwo,    Key >();
+    generic_key_check< BSTEytPrefThree,  Key >();
+    generic_key_check< BSTEytPrefFour,   Key >();
+    generic_key_check< BSTEytPrefProb,   Key >();
+    generic_key_check< BSTEytBranchless, Key >();
+    generic_key_check< BSTEytAdaptive,   Key >();
+    generic_key_check< BSTEytAligned,    Key >();
+    generic_key_check< BSTSTree,         Key >();
+    if constexpr (std::is_arithmetic_v<Key>)
+        generic_key_check< BSTPgm,       Key >();
+}
+
 int main()
 {
     sanity_check< BSTVEB<int>           >();
+    sanity_check< BSTPreorder<int>      >();
     sanity_check< BSTEyt<int>           >();
     sanity_check< BSTEytPref<int>       >();
     sanity_check< BSTEytPrefTwo<int>    >();
     sanity_check< BSTEytPrefThree<int>  >();
     sanity_check< BSTEytPrefFour<int>   >();
     sanity_check< BSTEytPrefProb<int>   >();
+    sanity_check< BSTEytBranchless<int> >();
+    sanity_check< BSTSTree<int>         >();
+    sanity_check< BSTEytCompressed<int> >();
+    sanity_check< BSTEytAdaptive<int>   >();
+    sanity_check< BSTEytAligned<int>    >();
+    sanity_check< BSTPgm<int>           >();
+    lower_bound_check< BSTVEB<int>           >();
+    lower_bound_check< BSTPreorder<int>      >();
+    lower_bound_check< BSTEytBranchless<int> >();
+    lower_bound_check< BSTSTree<int>         >();
+    lower_bound_check< BSTEytCompressed<int> >();
+    lower_bound_check< BSTEytAdaptive<int>   >();
+    lower_bound_check< BSTEytAligned<int>    >();
+    lower_bound_check< BSTPgm<int>           >();
+    radix_sort_check< int           >();
+    radix_sort_check< std::int64_t  >();
+    radix_sort_check< std::uint64_t >();
+    in_place_check< BSTPreorder<int>      >();
+    in_place_check< BSTEyt<int>           >();
+    in_place_check< BSTEytBranchless<int> >();
+    in_place_check< BSTVEB<int>           >();
+    veb_check();
+    compressed_check();
+    adaptive_check();
+    pgm_check< int           >();
+    pgm_check< std::int64_t  >();
+    pgm_check< std::uint64_t >();
+    pgm_check< double        >();
+    generic_family_check< std::uint64_t   >();
+    generic_family_check< double          >();
+    generic_family_check< FixedString<16> >();
+    // large enough to take the mmap path of the huge-page allocator
+    sanity_check< BSTVEB<int, HugePageAllocator<int>>   >(1 << 19);
+    sanity_check< BSTPreorder<int, HugePageAllocator<int>> >(1 << 19);
+    sanity_check< BSTEyt<int, HugePageAllocator<int>>   >(1 << 19);
+    sanity_check< BSTEytAligned<int, HugePageAllocator<int>> >(1 << 19);
+    sanity_check< BSTSTree<int, HugePageAllocator<int>> >(1 << 19);
+    for (std::size_t g : {1, 3, 16, 64}) {
+        batch_check< BSTVEB<int>     >(g);
+        batch_check< BSTPreorder<int> >(g);
+        batch_check< BSTEyt<int>     >(g);
+        batch_check< BSTEytPref<int> >(g);
+        batch_check< BSTEytAligned<int> >(g);
+    }
+    batch_check< BSTVEB<int> >(16, 100'003);   // partial subtrees below the top cut
+    for (KeyMode mode : {KeyMode::Set, KeyMode::Multiset}) {
+        ordered_check< BSTEyt<int>           >(mode);
+        ordered_check< BSTEytBranchless<int> >(mode);
+        ordered_check< BSTEytPrefProb<int>   >(mode);
+        ordered_check< BSTEytAdaptive<int>   >(mode);
+    }
+    lsm_check();
+    concurrent_check< BSTVEB<int>           >();
+    concurrent_check< BSTPreorder<int>      >();
+    concurrent_check< BSTEytBranchless<int> >();
+    concurrent_check< BSTEytPrefProb<int>   >();
+    concurrent_check< BSTSTree<int>         >();
+    index_file_check< BSTVEB<int>,           BSTEyt<int> >();
+    index_file_check< BSTPreorder<int>,      BSTVEB<int> >();
+    index_file_check< BSTVEB<int>,           BSTPreorder<int> >();
+    index_file_check< BSTEyt<int>,           BSTVEB<int> >();
+    index_file_check< BSTEytBranchless<int>, BSTVEB<int> >();
+    index_file_check< BSTEytPrefProb<int>,   BSTVEB<int> >();
+    index_file_check< BSTEytAdaptive<int>,   BSTVEB<int> >();
+    index_file_corrupt_check();
 
 
     std::cout << "all imps contains() tests passed\n";